@@ -0,0 +1,507 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCKCOMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+bool isBlockCompressed(TextureFormat format)
+{
+	return format != TextureFormat::RGBA8;
+}
+
+uint32_t getBlockBytes(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::BC1:
+	case TextureFormat::BC4:
+		return 8;
+	case TextureFormat::BC3:
+	case TextureFormat::BC5:
+	case TextureFormat::BC7:
+		return 16;
+	default:
+		return 4; // one texel for uncompressed RGBA8
+	}
+}
+
+size_t getLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	if (!isBlockCompressed(format)) {
+		return static_cast<size_t>(width) * height * 4;
+	}
+	size_t blocksX = (width + 3) / 4;
+	size_t blocksY = (height + 3) / 4;
+	return blocksX * blocksY * getBlockBytes(format);
+}
+
+// Principal axis of the block colors, found with a few power iterations on the covariance matrix
+static void findPrincipalAxis(const uint8_t texels[64], int channels, float mean[4], float axis[4])
+{
+	for (int c = 0; c < 4; c++) {
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+
+	float covariance[4][4] = {};
+#ifdef BLOCKCOMPRESSION_SSE2
+	// One texel per register, every lane adds up the same terms in the same order as the scalar loops
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 channelMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, channels == 4 ? -1 : 0));
+	__m128 colors[16];
+	__m128 sum = _mm_setzero_ps();
+	for (int i = 0; i < 16; i++) {
+		int32_t texel;
+		std::memcpy(&texel, texels + i * 4, 4);
+		__m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texel), zero), zero);
+		colors[i] = _mm_and_ps(_mm_cvtepi32_ps(wide), channelMask);
+		sum = _mm_add_ps(sum, colors[i]);
+	}
+	__m128 meanVector = _mm_mul_ps(sum, _mm_set1_ps(1.0f / 16.0f));
+	_mm_storeu_ps(mean, meanVector);
+
+	__m128 rows[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+	for (int i = 0; i < 16; i++) {
+		__m128 d = _mm_sub_ps(colors[i], meanVector);
+		rows[0] = _mm_add_ps(rows[0], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0))));
+		rows[1] = _mm_add_ps(rows[1], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))));
+		rows[2] = _mm_add_ps(rows[2], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2))));
+		rows[3] = _mm_add_ps(rows[3], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+	for (int a = 0; a < 4; a++) {
+		_mm_storeu_ps(covariance[a], rows[a]);
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < channels; c++) {
+			mean[c] += texels[i * 4 + c];
+		}
+	}
+	for (int c = 0; c < channels; c++) {
+		mean[c] /= 16.0f;
+	}
+
+	for (int i = 0; i < 16; i++) {
+		float d[4] = {};
+		for (int c = 0; c < channels; c++) {
+			d[c] = texels[i * 4 + c] - mean[c];
+		}
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				covariance[a][b] += d[a] * d[b];
+			}
+		}
+	}
+#endif
+
+	float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				next[a] += covariance[a][b] * v[b];
+			}
+		}
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			length = std::max(length, std::fabs(next[c]));
+		}
+		if (length < 1e-6f) {
+			break;
+		}
+		for (int c = 0; c < channels; c++) {
+			v[c] = next[c] / length;
+		}
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		length += v[c] * v[c];
+	}
+	length = std::sqrt(length);
+	for (int c = 0; c < channels; c++) {
+		axis[c] = length > 0.0f ? v[c] / length : 0.0f;
+	}
+}
+
+// Endpoints at the extremes of the block projected onto the principal axis, slightly inset
+static void findEndpoints(const uint8_t texels[64], int channels, float e0[4], float e1[4])
+{
+	float mean[4];
+	float axis[4];
+	findPrincipalAxis(texels, channels, mean, axis);
+
+	float minT = 0.0f;
+	float maxT = 0.0f;
+#ifdef BLOCKCOMPRESSION_SSE2
+	// Four texels per iteration with one channel of each in a register, the projection adds up in channel order like below
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	__m128 minimum = _mm_setzero_ps();
+	__m128 maximum = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4) {
+		__m128i quad = _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i * 4));
+		__m128 t = _mm_setzero_ps();
+		for (int c = 0; c < channels; c++) {
+			__m128 value = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(quad, _mm_cvtsi32_si128(c * 8)), byteMask));
+			t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(value, _mm_set1_ps(mean[c])), _mm_set1_ps(axis[c])));
+		}
+		minimum = _mm_min_ps(minimum, t);
+		maximum = _mm_max_ps(maximum, t);
+	}
+	minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+	minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+	maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(1, 0, 3, 2)));
+	maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(2, 3, 0, 1)));
+	minT = _mm_cvtss_f32(minimum);
+	maxT = _mm_cvtss_f32(maximum);
+#else
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			t += (texels[i * 4 + c] - mean[c]) * axis[c];
+		}
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+#endif
+
+	float inset = (maxT - minT) / 16.0f;
+	minT += inset;
+	maxT -= inset;
+	for (int c = 0; c < 4; c++) {
+		e0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+		e1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+	}
+}
+
+// Closest palette entry for each texel by squared RGB (channels 3) or RGBA distance, ties go to the lower index.
+// paletteSize is 4 or 16, returns the summed error of the block.
+static int64_t findClosestIndices(const uint8_t texels[64], const int palette[][4], int paletteSize, int channels, uint8_t indices[16])
+{
+	int64_t totalError = 0;
+#ifdef BLOCKCOMPRESSION_SSE2
+	// Four entries per register as 16 bit (r, g) and (b, a) pairs, _mm_madd_epi16 squares and adds two channels at once.
+	// Errors are compared as (error << 4) | index, so the minimum carries its index and keeps the scalar tie order.
+	__m128i paletteRG[4];
+	__m128i paletteBA[4];
+	__m128i order[4];
+	int groups = paletteSize / 4;
+	for (int j = 0; j < groups; j++) {
+		alignas(16) int16_t rg[8];
+		alignas(16) int16_t ba[8];
+		for (int k = 0; k < 4; k++) {
+			const int* entry = palette[j * 4 + k];
+			rg[k * 2] = static_cast<int16_t>(entry[0]);
+			rg[k * 2 + 1] = static_cast<int16_t>(entry[1]);
+			ba[k * 2] = static_cast<int16_t>(entry[2]);
+			ba[k * 2 + 1] = static_cast<int16_t>(channels == 4 ? entry[3] : 0);
+		}
+		paletteRG[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(rg));
+		paletteBA[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(ba));
+		order[j] = _mm_setr_epi32(j * 4, j * 4 + 1, j * 4 + 2, j * 4 + 3);
+	}
+
+	auto minimum = [](__m128i a, __m128i b) {
+		__m128i less = _mm_cmplt_epi32(a, b);
+		return _mm_or_si128(_mm_and_si128(less, a), _mm_andnot_si128(less, b));
+	};
+	for (int i = 0; i < 16; i++) {
+		const uint8_t* texel = texels + i * 4;
+		__m128i rg = _mm_set1_epi32(texel[0] | (texel[1] << 16));
+		__m128i ba = _mm_set1_epi32(texel[2] | (channels == 4 ? texel[3] << 16 : 0));
+		__m128i best = _mm_set1_epi32(INT32_MAX);
+		for (int j = 0; j < groups; j++) {
+			__m128i dRG = _mm_sub_epi16(rg, paletteRG[j]);
+			__m128i dBA = _mm_sub_epi16(ba, paletteBA[j]);
+			__m128i error = _mm_add_epi32(_mm_madd_epi16(dRG, dRG), _mm_madd_epi16(dBA, dBA));
+			best = minimum(best, _mm_or_si128(_mm_slli_epi32(error, 4), order[j]));
+		}
+		best = minimum(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+		best = minimum(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+		int key = _mm_cvtsi128_si32(best);
+		indices[i] = static_cast<uint8_t>(key & 15);
+		totalError += key >> 4;
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		int bestError = INT32_MAX;
+		for (int k = 0; k < paletteSize; k++) {
+			int error = 0;
+			for (int c = 0; c < channels; c++) {
+				int d = texels[i * 4 + c] - palette[k][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				best = k;
+			}
+		}
+		indices[i] = static_cast<uint8_t>(best);
+		totalError += bestError;
+	}
+#endif
+	return totalError;
+}
+
+static uint16_t packRGB565(const float color[4])
+{
+	uint16_t r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+	uint16_t g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+	uint16_t b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+void encodeBlockBC1(const uint8_t texels[64], uint8_t out[8])
+{
+	float e0[4];
+	float e1[4];
+	findEndpoints(texels, 3, e0, e1);
+
+	uint16_t c0 = packRGB565(e0);
+	uint16_t c1 = packRGB565(e1);
+
+	// Four color mode requires c0 > c1
+	if (c0 < c1) {
+		std::swap(c0, c1);
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		int palette[4][4] = {};
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		uint8_t closest[16];
+		findClosestIndices(texels, palette, 4, 3, closest);
+		for (int i = 0; i < 16; i++) {
+			indices |= static_cast<uint32_t>(closest[i]) << (i * 2);
+		}
+	}
+
+	out[0] = static_cast<uint8_t>(c0 & 0xFF);
+	out[1] = static_cast<uint8_t>(c0 >> 8);
+	out[2] = static_cast<uint8_t>(c1 & 0xFF);
+	out[3] = static_cast<uint8_t>(c1 >> 8);
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+void encodeBlockBC4(const uint8_t texels[64], int channel, uint8_t out[8])
+{
+	int a0 = 0;
+	int a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, static_cast<int>(texels[i * 4 + channel]));
+		a1 = std::min(a1, static_cast<int>(texels[i * 4 + channel]));
+	}
+
+	out[0] = static_cast<uint8_t>(a0);
+	out[1] = static_cast<uint8_t>(a1);
+
+	// Eight value mode (a0 > a1): both endpoints plus six interpolated values
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		int palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		for (int p = 2; p < 8; p++) {
+			palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+		}
+
+		for (int i = 0; i < 16; i++) {
+			int value = texels[i * 4 + channel];
+			int best = 0;
+			int bestError = INT32_MAX;
+			for (int p = 0; p < 8; p++) {
+				int error = std::abs(value - palette[p]);
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= static_cast<uint64_t>(best) << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+void encodeBlockBC3(const uint8_t texels[64], uint8_t out[16])
+{
+	encodeBlockBC4(texels, 3, out);
+	encodeBlockBC1(texels, out + 8);
+}
+
+void encodeBlockBC5(const uint8_t texels[64], uint8_t out[16])
+{
+	encodeBlockBC4(texels, 0, out);
+	encodeBlockBC4(texels, 1, out + 8);
+}
+
+// Little endian bit writer for 128 bit BC7 blocks
+struct BlockBitWriter
+{
+	uint8_t* out;
+	uint32_t position = 0;
+
+	void write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, position++) {
+			out[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (position & 7));
+		}
+	}
+};
+
+static const int kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a unique p-bit each and 4 bit indices
+void encodeBlockBC7(const uint8_t texels[64], uint8_t out[16])
+{
+	float e0[4];
+	float e1[4];
+	findEndpoints(texels, 4, e0, e1);
+
+	int bestEndpoints[2][4] = {};
+	int bestPBits[2] = {};
+	uint8_t bestIndices[16] = {};
+	int64_t bestError = INT64_MAX;
+
+	// Try every p-bit combination, keep the one with the lowest error
+	for (int pbits = 0; pbits < 4; pbits++) {
+		int p[2] = { pbits & 1, (pbits >> 1) & 1 };
+		int quantized[2][4];
+		int palette[16][4];
+		int endpoints[2][4];
+
+		for (int c = 0; c < 4; c++) {
+			const float* e[2] = { e0, e1 };
+			for (int k = 0; k < 2; k++) {
+				int q = static_cast<int>(std::lround((e[k][c] - p[k]) / 2.0f));
+				quantized[k][c] = std::clamp(q, 0, 127);
+				endpoints[k][c] = (quantized[k][c] << 1) | p[k];
+			}
+		}
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				palette[i][c] = ((64 - kBC7Weights4[i]) * endpoints[0][c] + kBC7Weights4[i] * endpoints[1][c] + 32) >> 6;
+			}
+		}
+
+		uint8_t indices[16];
+		int64_t totalError = findClosestIndices(texels, palette, 16, 4, indices);
+
+		if (totalError < bestError) {
+			bestError = totalError;
+			std::memcpy(bestEndpoints, quantized, sizeof(quantized));
+			bestPBits[0] = p[0];
+			bestPBits[1] = p[1];
+			std::memcpy(bestIndices, indices, sizeof(indices));
+		}
+	}
+
+	// The anchor index is stored with an implicit zero MSB, swap endpoints if needed
+	if (bestIndices[0] & 8) {
+		for (int c = 0; c < 4; c++) {
+			std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+		}
+		std::swap(bestPBits[0], bestPBits[1]);
+		for (int i = 0; i < 16; i++) {
+			bestIndices[i] = static_cast<uint8_t>(15 - bestIndices[i]);
+		}
+	}
+
+	std::memset(out, 0, 16);
+	BlockBitWriter writer{ out };
+	writer.write(1u << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.write(static_cast<uint32_t>(bestEndpoints[0][c]), 7);
+		writer.write(static_cast<uint32_t>(bestEndpoints[1][c]), 7);
+	}
+	writer.write(static_cast<uint32_t>(bestPBits[0]), 1);
+	writer.write(static_cast<uint32_t>(bestPBits[1]), 1);
+	writer.write(bestIndices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		writer.write(bestIndices[i], 4);
+	}
+}
+
+static void encodeBlock(const uint8_t texels[64], TextureFormat format, uint8_t* out)
+{
+	switch (format) {
+	case TextureFormat::BC1: encodeBlockBC1(texels, out); break;
+	case TextureFormat::BC3: encodeBlockBC3(texels, out); break;
+	case TextureFormat::BC4: encodeBlockBC4(texels, 0, out); break;
+	case TextureFormat::BC5: encodeBlockBC5(texels, out); break;
+	case TextureFormat::BC7: encodeBlockBC7(texels, out); break;
+	default: break;
+	}
+}
+
+void compressImage(const uint8_t* pixels, uint32_t width, uint32_t height, TextureFormat format, uint8_t* out, uint32_t threadCount)
+{
+	if (!isBlockCompressed(format)) {
+		std::memcpy(out, pixels, getLevelSize(format, width, height));
+		return;
+	}
+
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint32_t blockBytes = getBlockBytes(format);
+
+	// Workers pull rows of blocks until the image is done
+	std::atomic<uint32_t> nextRow{ 0 };
+	auto worker = [&]() {
+		uint8_t texels[64];
+		for (uint32_t by = nextRow++; by < blocksY; by = nextRow++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				// Gather the block, edges of non multiple-of-four images repeat the last texel
+				for (uint32_t y = 0; y < 4; y++) {
+					uint32_t sy = std::min(by * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++) {
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						std::memcpy(texels + (y * 4 + x) * 4, pixels + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+					}
+				}
+				encodeBlock(texels, format, out + (static_cast<size_t>(by) * blocksX + bx) * blockBytes);
+			}
+		}
+	};
+
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threadCount = std::min(threadCount, blocksY);
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Texel formats understood by the texture tools and the texture file
+enum class TextureFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1,	// RGB, 4 bits per texel
+	BC3 = 2,	// RGBA with interpolated alpha, 8 bits per texel
+	BC4 = 3,	// single channel, 4 bits per texel
+	BC5 = 4,	// two channels (normal maps), 8 bits per texel
+	BC7 = 5		// high quality RGBA, 8 bits per texel
+};
+
+bool isBlockCompressed(TextureFormat format);
+uint32_t getBlockBytes(TextureFormat format);
+size_t getLevelSize(TextureFormat format, uint32_t width, uint32_t height);
+
+// Single 4x4 block encoders, texels are RGBA8 in row order
+void encodeBlockBC1(const uint8_t texels[64], uint8_t out[8]);
+void encodeBlockBC3(const uint8_t texels[64], uint8_t out[16]);
+void encodeBlockBC4(const uint8_t texels[64], int channel, uint8_t out[8]);
+void encodeBlockBC5(const uint8_t texels[64], uint8_t out[16]);
+void encodeBlockBC7(const uint8_t texels[64], uint8_t out[16]);
+
+// Compresses an RGBA8 image, rows of blocks are spread over threadCount workers (0 = all cores)
+void compressImage(const uint8_t* pixels, uint32_t width, uint32_t height, TextureFormat format, uint8_t* out, uint32_t threadCount = 0);
@@ -0,0 +1,520 @@
+// DecodeBenchmark.cpp: CPU cost of the stb_image decode paths, needs no GPU.
+//
+// JPEG: times the kernels (IDCT, 2x2 chroma upsampling, YCbCr to RGB) with the kernel set
+// limited to scalar, SSE2, AVX2 and AVX-512BW. Levels the CPU lacks are skipped.
+// PNG: encodes a corpus of synthetic images and decodes it with the checked inflate loop and
+// scalar unfiltering (the code before the fast paths), with the fast inflate loop and with
+// the fast loop and SSE2 unfiltering. Every decode has to match the source pixels.
+// Files given on the command line are decoded the same way, JPEGs at every kernel level.
+// Prints the best time over a number of runs.
+//
+// Usage: DecodeBenchmark [image.jpg|image.png ...]
+#define STB_IMAGE_IMPLEMENTATION
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include "stb_image.h"
+
+static constexpr uint32_t Runs = 20;
+
+struct Level
+{
+	int limit;
+	const char* name;
+};
+
+static const Level Levels[] = { { -1, "scalar" }, { 0, "SSE2" }, { 1, "AVX2" }, { 2, "AVX-512" } };
+
+// Widest kernel set this build and CPU can run, see stbi__simd_limit
+static int getMaxLevel()
+{
+#if defined(STBI_AVX2)
+	return stbi__avx_level();
+#elif defined(STBI_SSE2)
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static void setLevel(int limit)
+{
+#ifdef STBI_SSE2
+	stbi__simd_limit = limit;
+#else
+	(void)limit;
+#endif
+}
+
+// PNG decode paths, see stbi__zfast and stbi__simd_limit
+struct PngConfig
+{
+	int fastInflate;
+	int level;
+	const char* name;
+};
+
+static const PngConfig PngConfigs[] = { { 0, -1, "baseline" }, { 1, -1, "fast inflate" }, { 1, 0, "fast inflate + SSE2 unfilter" } };
+
+// Best run in nanoseconds, the first runs warm up the caches
+static double measure(const std::function<void()>& run)
+{
+	double best = 1e30;
+	for (uint32_t i = 0; i < Runs; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static int maxDifference(const stbi_uc* a, const stbi_uc* b, size_t size)
+{
+	int difference = 0;
+	for (size_t i = 0; i < size; i++) {
+		difference = std::max(difference, std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+	}
+	return difference;
+}
+
+// Inputs of the kernel benchmark, one row of horizontally adjacent 8x8 blocks as the decoder sees it
+struct KernelData
+{
+	static constexpr int Blocks = 64;
+	static constexpr int Width = Blocks * 8;
+	static constexpr int Repeats = 100;
+
+	alignas(16) short coefficients[Blocks * 64];
+	alignas(16) stbi_uc blockPixels[8 * Width];
+	stbi_uc nearRow[Width / 2], farRow[Width / 2];
+	stbi_uc upsampled[Width];
+	stbi_uc y[Width], cb[Width], cr[Width];
+	stbi_uc rgba[Width * 4];
+};
+
+// Dequantized coefficients with the energy in the low frequencies, like a photo at normal quality
+static void fillKernelData(KernelData& data)
+{
+	uint32_t seed = 12345;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 16; };
+	for (int block = 0; block < KernelData::Blocks; block++) {
+		short* coefficients = data.coefficients + block * 64;
+		for (int i = 0; i < 64; i++) {
+			int u = i % 8, v = i / 8;
+			if (i == 0) coefficients[i] = static_cast<short>(static_cast<int>(next() % 1024) - 512);
+			else if (u + v < 4) coefficients[i] = static_cast<short>(static_cast<int>(next() % 128) - 64);
+			else coefficients[i] = 0;
+		}
+	}
+	for (int i = 0; i < KernelData::Width / 2; i++) {
+		data.nearRow[i] = static_cast<stbi_uc>(next());
+		data.farRow[i] = static_cast<stbi_uc>(next());
+	}
+	for (int i = 0; i < KernelData::Width; i++) {
+		data.y[i] = static_cast<stbi_uc>(next());
+		data.cb[i] = static_cast<stbi_uc>(next());
+		data.cr[i] = static_cast<stbi_uc>(next());
+	}
+}
+
+struct KernelResult
+{
+	double idct;		// ns per block
+	double upsample;	// ns per output pixel
+	double colorConvert;	// ns per pixel
+	std::vector<stbi_uc> blockPixels, upsampled, rgba;
+};
+
+// Times the kernels stbi__setup_jpeg picks at the current limit
+static KernelResult measureKernels(KernelData& data)
+{
+	std::unique_ptr<stbi__jpeg> jpeg(new stbi__jpeg());
+	stbi__setup_jpeg(jpeg.get());
+
+	KernelResult result;
+	result.idct = measure([&]() {
+		for (int i = 0; i < KernelData::Repeats; i++) {
+			stbi__jpeg_idct_blocks(jpeg.get(), data.blockPixels, KernelData::Width, data.coefficients, KernelData::Blocks);
+		}
+	}) / (KernelData::Repeats * KernelData::Blocks);
+	result.upsample = measure([&]() {
+		for (int i = 0; i < KernelData::Repeats; i++) {
+			jpeg->resample_row_hv_2_kernel(data.upsampled, data.nearRow, data.farRow, KernelData::Width / 2, 2);
+		}
+	}) / (KernelData::Repeats * KernelData::Width);
+	result.colorConvert = measure([&]() {
+		for (int i = 0; i < KernelData::Repeats; i++) {
+			jpeg->YCbCr_to_RGB_kernel(data.rgba, data.y, data.cb, data.cr, KernelData::Width, 4);
+		}
+	}) / (KernelData::Repeats * KernelData::Width);
+
+	result.blockPixels.assign(data.blockPixels, data.blockPixels + sizeof(data.blockPixels));
+	result.upsampled.assign(data.upsampled, data.upsampled + sizeof(data.upsampled));
+	result.rgba.assign(data.rgba, data.rgba + sizeof(data.rgba));
+	return result;
+}
+
+static void benchmarkKernels(int maxLevel)
+{
+	std::unique_ptr<KernelData> data(new KernelData());
+	fillKernelData(*data);
+
+	std::cout << "JPEG kernels (ns per block / output pixel / pixel, max difference to scalar)" << std::endl;
+	KernelResult scalar;
+	for (const Level& level : Levels) {
+		if (level.limit > maxLevel) {
+			break;
+		}
+		setLevel(level.limit);
+		KernelResult result = measureKernels(*data);
+		if (level.limit < 0) {
+			scalar = result;
+		}
+		std::cout << "  " << level.name
+			<< ": idct " << result.idct << " (" << maxDifference(result.blockPixels.data(), scalar.blockPixels.data(), scalar.blockPixels.size()) << ")"
+			<< ", upsample " << result.upsample << " (" << maxDifference(result.upsampled.data(), scalar.upsampled.data(), scalar.upsampled.size()) << ")"
+			<< ", ycbcr " << result.colorConvert << " (" << maxDifference(result.rgba.data(), scalar.rgba.data(), scalar.rgba.size()) << ")"
+			<< std::endl;
+	}
+}
+
+static bool readFile(const std::string& path, std::vector<stbi_uc>& bytes)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Decodes a JPEG file at every level, the scalar decode is the reference
+static void benchmarkJpeg(const std::string& path, const std::vector<stbi_uc>& bytes, int maxLevel)
+{
+	std::vector<stbi_uc> reference;
+	double scalarTime = 0.0;
+	for (const Level& level : Levels) {
+		if (level.limit > maxLevel) {
+			break;
+		}
+		setLevel(level.limit);
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pixels = nullptr;
+		double time = measure([&]() {
+			stbi_image_free(pixels);
+			pixels = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channels, 0);
+		});
+		if (!pixels) {
+			std::cerr << path << ": " << stbi_failure_reason() << std::endl;
+			return;
+		}
+		size_t size = static_cast<size_t>(width) * height * channels;
+		if (level.limit < 0) {
+			reference.assign(pixels, pixels + size);
+			scalarTime = time;
+			std::cout << path << " (" << width << "x" << height << ", " << channels << " channels)" << std::endl;
+		}
+		std::cout << "  " << level.name << ": " << time / 1e6 << " ms, "
+			<< static_cast<double>(width) * height * 1e3 / time << " MPixel/s, "
+			<< scalarTime / time << "x scalar, max difference " << maxDifference(pixels, reference.data(), size) << std::endl;
+		stbi_image_free(pixels);
+	}
+	setLevel(maxLevel);
+}
+
+// Decodes a PNG with every config, the baseline decode is the reference unless the source pixels are given
+static void benchmarkPng(const std::string& name, const std::vector<stbi_uc>& bytes, int maxLevel, const std::vector<stbi_uc>* source)
+{
+	std::vector<stbi_uc> reference;
+	if (source) {
+		reference = *source;
+	}
+	double baselineTime = 0.0;
+	for (const PngConfig& config : PngConfigs) {
+		if (config.level > maxLevel) {
+			break;
+		}
+		stbi__zfast = config.fastInflate;
+		setLevel(config.level);
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pixels = nullptr;
+		double time = measure([&]() {
+			stbi_image_free(pixels);
+			pixels = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channels, 0);
+		});
+		if (!pixels) {
+			std::cerr << name << ": " << stbi_failure_reason() << std::endl;
+			break;
+		}
+		size_t size = static_cast<size_t>(width) * height * channels;
+		if (config.fastInflate == 0) {
+			baselineTime = time;
+			if (reference.empty()) {
+				reference.assign(pixels, pixels + size);
+			}
+			std::cout << name << " (" << width << "x" << height << ", " << channels << " channels, " << bytes.size() / 1024 << " KB)" << std::endl;
+		}
+		bool match = reference.size() == size && std::equal(reference.begin(), reference.end(), pixels);
+		std::cout << "  " << config.name << ": " << time / 1e6 << " ms, "
+			<< static_cast<double>(width) * height * 1e3 / time << " MPixel/s, "
+			<< baselineTime / time << "x baseline" << (match ? "" : ", pixels differ!") << std::endl;
+		stbi_image_free(pixels);
+	}
+	stbi__zfast = 1;
+	setLevel(maxLevel);
+}
+
+// Minimal PNG writer for the corpus: one IDAT chunk, deflate with fixed Huffman codes and greedy LZ77 matching
+class PngWriter
+{
+private:
+	std::vector<stbi_uc> m_bytes;
+	uint32_t m_bits = 0;
+	int m_bitCount = 0;
+
+	void writeBits(uint32_t value, int count)
+	{
+		m_bits |= value << m_bitCount;
+		m_bitCount += count;
+		while (m_bitCount >= 8) {
+			m_bytes.push_back(static_cast<stbi_uc>(m_bits));
+			m_bits >>= 8;
+			m_bitCount -= 8;
+		}
+	}
+
+	// Huffman codes are stored starting with their most significant bit
+	void writeCode(uint32_t code, int length)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < length; i++) {
+			reversed |= ((code >> i) & 1) << (length - 1 - i);
+		}
+		writeBits(reversed, length);
+	}
+
+	void writeLiteral(int symbol)
+	{
+		if (symbol < 144) writeCode(0x30 + symbol, 8);
+		else if (symbol < 256) writeCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280) writeCode(symbol - 256, 7);
+		else writeCode(0xc0 + symbol - 280, 8);
+	}
+
+	void writeMatch(int length, int distance)
+	{
+		static const int lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const int lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const int distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const int distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		int code = 28;
+		while (lengthBase[code] > length) code--;
+		writeLiteral(257 + code);
+		writeBits(length - lengthBase[code], lengthExtra[code]);
+		code = 29;
+		while (distanceBase[code] > distance) code--;
+		writeCode(code, 5);
+		writeBits(distance - distanceBase[code], distanceExtra[code]);
+	}
+
+	void deflate(const std::vector<stbi_uc>& data)
+	{
+		static constexpr int HashBits = 15, Window = 32768, MaxChain = 16, MaxMatch = 258;
+		std::vector<int> head(1 << HashBits, -1), previous(data.size(), -1);
+		int size = static_cast<int>(data.size());
+		auto hash = [&](int i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & ((1 << HashBits) - 1); };
+		auto insert = [&](int i) { if (i + 2 < size) { int h = hash(i); previous[i] = head[h]; head[h] = i; } };
+
+		writeBits(1, 1);	// final block
+		writeBits(1, 2);	// fixed Huffman codes
+		for (int i = 0; i < size;) {
+			int bestLength = 0, bestDistance = 0;
+			if (i + 2 < size) {
+				int limit = std::min(MaxMatch, size - i);
+				int candidate = head[hash(i)];
+				for (int chain = 0; candidate >= 0 && i - candidate <= Window && chain < MaxChain; chain++, candidate = previous[candidate]) {
+					int length = 0;
+					while (length < limit && data[candidate + length] == data[i + length]) length++;
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = i - candidate;
+					}
+				}
+			}
+			if (bestLength >= 3) {
+				writeMatch(bestLength, bestDistance);
+				for (int end = i + bestLength; i < end; i++) insert(i);
+			}
+			else {
+				writeLiteral(data[i]);
+				insert(i++);
+			}
+		}
+		writeLiteral(256);
+		if (m_bitCount > 0) {
+			writeBits(0, 8 - m_bitCount);
+		}
+	}
+
+	void writeU32(uint32_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8) m_bytes.push_back(static_cast<stbi_uc>(value >> shift));
+	}
+
+	void writeChunk(const char* type, const std::vector<stbi_uc>& data)
+	{
+		writeU32(static_cast<uint32_t>(data.size()));
+		size_t start = m_bytes.size();
+		m_bytes.insert(m_bytes.end(), type, type + 4);
+		m_bytes.insert(m_bytes.end(), data.begin(), data.end());
+		uint32_t crc = 0xffffffffu;
+		for (size_t i = start; i < m_bytes.size(); i++) {
+			crc ^= m_bytes[i];
+			for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+		}
+		writeU32(crc ^ 0xffffffffu);
+	}
+
+public:
+	// filter -1 cycles through all five filter types row by row
+	std::vector<stbi_uc> write(const std::vector<stbi_uc>& pixels, int width, int height, int channels, int filter)
+	{
+		auto paeth = [](int a, int b, int c) {
+			int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+			return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+		};
+		int rowBytes = width * channels;
+		std::vector<stbi_uc> filtered;
+		filtered.reserve(static_cast<size_t>(rowBytes + 1) * height);
+		for (int y = 0; y < height; y++) {
+			int rowFilter = filter < 0 ? y % 5 : filter;
+			const stbi_uc* row = pixels.data() + static_cast<size_t>(y) * rowBytes;
+			const stbi_uc* above = y > 0 ? row - rowBytes : nullptr;
+			filtered.push_back(static_cast<stbi_uc>(rowFilter));
+			for (int i = 0; i < rowBytes; i++) {
+				int a = i >= channels ? row[i - channels] : 0;
+				int b = above ? above[i] : 0;
+				int c = above && i >= channels ? above[i - channels] : 0;
+				int predicted = 0;
+				switch (rowFilter) {
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) >> 1; break;
+				case 4: predicted = paeth(a, b, c); break;
+				}
+				filtered.push_back(static_cast<stbi_uc>(row[i] - predicted));
+			}
+		}
+
+		m_bytes.clear();
+		m_bits = 0;
+		m_bitCount = 0;
+		m_bytes.push_back(0x78);	// zlib header, 32 KB window
+		m_bytes.push_back(0x01);
+		deflate(filtered);
+		uint32_t s1 = 1, s2 = 0;
+		for (stbi_uc byte : filtered) {
+			s1 = (s1 + byte) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+		writeU32((s2 << 16) | s1);
+		std::vector<stbi_uc> zlib;
+		m_bytes.swap(zlib);
+
+		static const stbi_uc signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		m_bytes.assign(signature, signature + 8);
+		std::vector<stbi_uc> ihdr;
+		for (uint32_t value : { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }) {
+			for (int shift = 24; shift >= 0; shift -= 8) ihdr.push_back(static_cast<stbi_uc>(value >> shift));
+		}
+		ihdr.push_back(8);	// bit depth
+		ihdr.push_back(channels == 4 ? 6 : 2);
+		ihdr.push_back(0);
+		ihdr.push_back(0);
+		ihdr.push_back(0);
+		writeChunk("IHDR", ihdr);
+		writeChunk("IDAT", zlib);
+		writeChunk("IEND", {});
+		return std::move(m_bytes);
+	}
+};
+
+// Smooth gradients with sensor noise like a photo, or flat tiles with hard edges like UI art
+static std::vector<stbi_uc> createCorpusPixels(int width, int height, int channels, bool photo)
+{
+	std::vector<stbi_uc> pixels(static_cast<size_t>(width) * height * channels);
+	uint32_t seed = 4711;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 16; };
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			stbi_uc* pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * channels;
+			for (int c = 0; c < channels; c++) {
+				int value;
+				if (c == 3) value = photo ? 255 - (x + y) / 16 : ((x / 64 + y / 64) % 3 == 0 ? 0 : 255);
+				else if (photo) value = (x * (c + 1) + y * (3 - c)) / 12 + static_cast<int>(next() % 9);
+				else value = ((x / 32) * 53 + (y / 32) * 97 + c * 71) % 256;
+				pixel[c] = static_cast<stbi_uc>(value);
+			}
+		}
+	}
+	return pixels;
+}
+
+static void benchmarkPngCorpus(int maxLevel)
+{
+	struct Entry
+	{
+		const char* name;
+		int channels;
+		bool photo;
+		int filter;
+	};
+	static const Entry Corpus[] = {
+		{ "photo RGBA, sub", 4, true, 1 },
+		{ "photo RGBA, average", 4, true, 3 },
+		{ "photo RGBA, paeth", 4, true, 4 },
+		{ "photo RGBA, mixed filters", 4, true, -1 },
+		{ "photo RGB, mixed filters", 3, true, -1 },
+		{ "flat RGBA, mixed filters", 4, false, -1 },
+	};
+	static constexpr int Size = 1024;
+
+	std::cout << "PNG corpus" << std::endl;
+	PngWriter writer;
+	for (const Entry& entry : Corpus) {
+		std::vector<stbi_uc> pixels = createCorpusPixels(Size, Size, entry.channels, entry.photo);
+		std::vector<stbi_uc> png = writer.write(pixels, Size, Size, entry.channels, entry.filter);
+		benchmarkPng(entry.name, png, maxLevel, &pixels);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int maxLevel = getMaxLevel();
+	std::cout << "Widest kernel set: " << (maxLevel >= 0 ? Levels[maxLevel + 1].name : "scalar") << std::endl;
+
+	benchmarkKernels(maxLevel);
+	benchmarkPngCorpus(maxLevel);
+	for (int i = 1; i < argc; i++) {
+		std::vector<stbi_uc> bytes;
+		if (!readFile(argv[i], bytes)) {
+			std::cerr << argv[i] << ": failed to read file!" << std::endl;
+			continue;
+		}
+		if (bytes.size() >= 8 && bytes[0] == 0x89 && bytes[1] == 'P') {
+			benchmarkPng(argv[i], bytes, maxLevel, nullptr);
+		}
+		else {
+			benchmarkJpeg(argv[i], bytes, maxLevel);
+		}
+	}
+	return 0;
+}
@@ -1,45 +1,289 @@
 #include "DefaultPipeline.h"
 #include <array>
+#include <algorithm>
 #include "Vertex.h"
 #include <stdexcept>
 #include "LibGFX.h"
 #include "DescriptorSetLayoutBuilder.h"
+#include "Texture.h"
+
+// Layout with a single binding 0, for what the layout builder does not cover (flags, immutable samplers)
+static VkDescriptorSetLayout createBindingLayout(VkDevice device, VkDescriptorType type, VkShaderStageFlags stages, const VkSampler* immutableSampler, VkDescriptorSetLayoutCreateFlags flags)
+{
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = type;
+	binding.descriptorCount = 1;
+	binding.stageFlags = stages;
+	binding.pImmutableSamplers = immutableSampler;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.flags = flags;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+	return layout;
+}
 
 void DefaultPipeline::create(LibGFX::VkContext& context)
 {
 	// Get device from context
 	VkDevice device = context.getDevice();
 
+	// Only requested when the device enabled VK_KHR_push_descriptor, otherwise textures use regular sets
+	if (m_pushDescriptors && !m_descriptorBuffers) {
+		m_cmdPushDescriptorSet = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR"));
+	}
+	m_pushDescriptors = m_cmdPushDescriptorSet != nullptr;
+	VkDescriptorSetLayoutCreateFlags layoutFlags = m_descriptorBuffers ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+
 	// Uniforms layout for projection and view matrices
 	LibGFX::DescriptorSetLayoutBuilder descriptorSetLayoutBuilder;
-	m_uniformsLayout = descriptorSetLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1)
-		.build(context);
-	descriptorSetLayoutBuilder.clear();
+	if (m_descriptorBuffers) {
+		m_uniformsLayout = createBindingLayout(device, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, layoutFlags);
+	}
+	else {
+		m_uniformsLayout = descriptorSetLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+			.build(context);
+		descriptorSetLayoutBuilder.clear();
+	}
 
-	m_textureLayout = descriptorSetLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
-		.build(context);
-	descriptorSetLayoutBuilder.clear();
+	// Texture layout, a constant sampler is baked in as immutable sampler. Only one set of a pipeline
+	// layout can be a push descriptor set, the per draw texture is the one that changes most.
+	if (m_immutableSampler != VK_NULL_HANDLE || m_pushDescriptors || m_descriptorBuffers) {
+		if (m_pushDescriptors) {
+			layoutFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+		}
+		m_textureLayout = createBindingLayout(device, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT,
+			m_immutableSampler != VK_NULL_HANDLE ? &m_immutableSampler : nullptr, layoutFlags);
+	}
+	else {
+		m_textureLayout = descriptorSetLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+			.build(context);
+		descriptorSetLayoutBuilder.clear();
+	}
 
+	// Shader modules are kept until destroy, variants are created on demand
 	// Vertex shader for this pipeline
 	auto vertexShaderCode = LibGFX::GFX::readFile("C:\\Users\\andy1\\source\\repos\\LibGFXTest\\Shader\\vert.spv");
-	auto vertexShaderModule = context.createShaderModule(vertexShaderCode);
+	m_vertexShader = context.createShaderModule(vertexShaderCode);
 
 	// Fragment shader for this pipeline
 	auto fragmentShaderCode = LibGFX::GFX::readFile("C:\\Users\\andy1\\source\\repos\\LibGFXTest\\Shader\\frag.spv");
-	auto fragmentShaderModule = context.createShaderModule(fragmentShaderCode);
+	m_fragmentShader = context.createShaderModule(fragmentShaderCode);
+
+	// Pipeline Layout
+	std::array<VkDescriptorSetLayout, 2> layouts = { m_uniformsLayout, m_textureLayout };
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+	pipelineLayoutInfo.pSetLayouts = layouts.data();
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	// Without fast linking the optimized link is the only one and runs inline
+	if (m_pipelineLibraries) {
+		VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties = {};
+		libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &libraryProperties;
+		vkGetPhysicalDeviceProperties2(context.getPhysicalDevice(), &properties);
+
+		m_fastLinking = libraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+	}
+	if (m_fastLinking) {
+		m_device = device;
+		m_stop = false;
+		m_worker = std::thread(&DefaultPipeline::workerLoop, this);
+	}
+
+	// The opaque variant is the default pipeline
+	m_pipeline = getVariant(context, PipelineState::opaque());
+}
+
+VkPipeline DefaultPipeline::getVariant(LibGFX::VkContext& context, const PipelineState& state)
+{
+	uint32_t key = state.getKey();
+	auto it = m_variants.find(key);
+	if (it != m_variants.end()) {
+		return it->second;
+	}
+
+	VkPipeline pipeline;
+	VkDevice device = context.getDevice();
+	if (m_pipelineLibraries) {
+		// Only the parts not built for an earlier variant are compiled, the rest is a link. The fast link is
+		// used right away and replaced once its optimized build finished (see updateVariants).
+		std::array<VkPipeline, 4> libraries = {
+			getLibrary(device, state, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT),
+			getLibrary(device, state, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT),
+			getLibrary(device, state, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT),
+			getLibrary(device, state, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+		};
+		pipeline = linkLibraries(device, libraries, !m_fastLinking);
+		if (m_fastLinking) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.push_back({ key, libraries });
+			}
+			m_wake.notify_one();
+		}
+	}
+	else {
+		pipeline = createPipeline(device, state, 0);
+	}
+	m_variants[key] = pipeline;
+	return pipeline;
+}
+
+void DefaultPipeline::updateVariants(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	std::vector<std::pair<uint32_t, VkPipeline>> optimized;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		optimized.swap(m_optimized);
+	}
+
+	for (auto& variant : optimized) {
+		VkPipeline& pipeline = m_variants[variant.first];
+		VkPipeline fastLinked = pipeline;
+		pipeline = variant.second;
+		if (m_pipeline == fastLinked) {
+			m_pipeline = variant.second;
+		}
+		deletionQueue.enqueue(lastValue, [fastLinked](LibGFX::VkContext& context) {
+			vkDestroyPipeline(context.getDevice(), fastLinked, nullptr);
+		});
+	}
+}
+
+VkPipeline DefaultPipeline::getLibrary(VkDevice device, const PipelineState& state, VkGraphicsPipelineLibraryFlagsEXT part)
+{
+	// A library is keyed by the state its part is built from only, variants share the others
+	PipelineState partState;
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) {
+		partState.depthWrite = state.depthWrite;
+		partState.depthCompare = state.depthCompare;
+		partState.depthOnly = state.depthOnly && !state.alphaTest;
+		partState.texture = state.texture;
+		partState.vertexColor = state.vertexColor;
+		partState.alphaTest = state.alphaTest;
+	}
+	else if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT) {
+		partState.blend = state.blend;
+		partState.depthOnly = state.depthOnly;
+	}
+
+	uint64_t key = (static_cast<uint64_t>(part) << 32) | partState.getKey();
+	auto it = m_libraries.find(key);
+	if (it != m_libraries.end()) {
+		return it->second;
+	}
+
+	VkPipeline library = createPipeline(device, partState, part);
+	m_libraries[key] = library;
+	return library;
+}
+
+VkPipeline DefaultPipeline::linkLibraries(VkDevice device, const std::array<VkPipeline, 4>& libraries, bool optimized) const
+{
+	VkPipelineLibraryCreateInfoKHR libraryInfo = {};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+	libraryInfo.pLibraries = libraries.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	pipelineInfo.flags = m_descriptorBuffers ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+	if (optimized) {
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+	}
+	pipelineInfo.layout = m_pipelineLayout;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to link graphics pipeline!");
+	}
+	return pipeline;
+}
+
+void DefaultPipeline::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+		if (m_stop) {
+			break;
+		}
+
+		OptimizeJob job = m_jobs.front();
+		m_jobs.pop_front();
+		lock.unlock();
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		try {
+			pipeline = linkLibraries(m_device, job.libraries, true);
+		}
+		catch (...) {
+			// The fast linked pipeline stays in use
+		}
+		lock.lock();
+		if (pipeline != VK_NULL_HANDLE) {
+			m_optimized.push_back({ job.key, pipeline });
+		}
+	}
+
+	// Builds not started yet are dropped, their variants keep the fast link
+	m_jobs.clear();
+}
+
+VkPipeline DefaultPipeline::createPipeline(VkDevice device, const PipelineState& state, VkGraphicsPipelineLibraryFlagsEXT libraryParts) const
+{
+	// Shader features are specialization constants (constant_id 0..2 in shader.frag), the driver
+	// removes the disabled paths when it compiles the variant
+	struct ShaderConstants
+	{
+		VkBool32 texture;
+		VkBool32 vertexColor;
+		VkBool32 alphaTest;
+	};
+	ShaderConstants constants = {};
+	constants.texture = state.texture ? VK_TRUE : VK_FALSE;
+	constants.vertexColor = state.vertexColor ? VK_TRUE : VK_FALSE;
+	constants.alphaTest = state.alphaTest ? VK_TRUE : VK_FALSE;
+
+	std::array<VkSpecializationMapEntry, 3> specializationEntries = {};
+	specializationEntries[0] = { 0, offsetof(ShaderConstants, texture), sizeof(VkBool32) };
+	specializationEntries[1] = { 1, offsetof(ShaderConstants, vertexColor), sizeof(VkBool32) };
+	specializationEntries[2] = { 2, offsetof(ShaderConstants, alphaTest), sizeof(VkBool32) };
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(ShaderConstants);
+	specializationInfo.pData = &constants;
 
 	// Shader Stage
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertexShaderModule;
+	vertShaderStageInfo.module = m_vertexShader;
 	vertShaderStageInfo.pName = "main";
 
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragmentShaderModule;
+	fragShaderStageInfo.module = m_fragmentShader;
 	fragShaderStageInfo.pName = "main";
+	fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
 	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
 
@@ -118,12 +362,13 @@ void DefaultPipeline::create(LibGFX::VkContext& context)
 	VkPipelineMultisampleStateCreateInfo multisampling = {};
 	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.rasterizationSamples = m_samples;
 
 	// Color Blending
 	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_TRUE;
+	// Blending is only on for transparent draws, a depth only variant writes no color
+	colorBlendAttachment.colorWriteMask = state.depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = state.blend ? VK_TRUE : VK_FALSE;
 	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -137,30 +382,30 @@ void DefaultPipeline::create(LibGFX::VkContext& context)
 	colorBlending.attachmentCount = 1;
 	colorBlending.pAttachments = &colorBlendAttachment;
 
-	// Pipeline Layout
-	std::array<VkDescriptorSetLayout, 2> layouts = { m_uniformsLayout, m_textureLayout };
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-	pipelineLayoutInfo.pSetLayouts = layouts.data();
-
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout!");
-	}
-
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = state.depthCompare;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.stencilTestEnable = VK_FALSE;
 
+	// Dynamic rendering has no render pass, the pipeline is created against the attachment formats
+	VkPipelineRenderingCreateInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &m_colorFormat;
+	renderingInfo.depthAttachmentFormat = m_depthFormat;
+	renderingInfo.stencilAttachmentFormat = hasStencilComponent(m_depthFormat) ? m_depthFormat : VK_FORMAT_UNDEFINED;
+
 	// Pipeline Create Info
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
-	pipelineInfo.pStages = shaderStages.data();
+	pipelineInfo.pNext = m_renderPass == VK_NULL_HANDLE ? &renderingInfo : nullptr;
+	pipelineInfo.flags = m_descriptorBuffers ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+	// The depth prepass runs the vertex stage only, alpha tested geometry keeps the fragment stage for its discard
+	uint32_t firstStage = 0;
+	uint32_t endStage = state.depthOnly && !state.alphaTest ? 1 : static_cast<uint32_t>(shaderStages.size());
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
 	pipelineInfo.pInputAssemblyState = &inputAssembly;
 	pipelineInfo.pViewportState = &viewportState;
@@ -173,13 +418,51 @@ void DefaultPipeline::create(LibGFX::VkContext& context)
 	pipelineInfo.renderPass = m_renderPass;
 	pipelineInfo.subpass = 0;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create graphics pipeline!");
+	// A library only carries the state and the shader stage of its parts
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {};
+	if (libraryParts != 0) {
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.pNext = pipelineInfo.pNext;
+		libraryInfo.flags = libraryParts;
+		pipelineInfo.pNext = &libraryInfo;
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+		const bool vertexInput = (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) != 0;
+		const bool preRasterization = (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) != 0;
+		const bool fragmentShader = (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) != 0;
+		const bool fragmentOutput = (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT) != 0;
+		firstStage = preRasterization ? 0 : 1;
+		endStage = fragmentShader ? endStage : 1;
+		endStage = std::max(firstStage, endStage);
+		if (!vertexInput) {
+			pipelineInfo.pVertexInputState = nullptr;
+			pipelineInfo.pInputAssemblyState = nullptr;
+		}
+		if (!preRasterization) {
+			pipelineInfo.pViewportState = nullptr;
+			pipelineInfo.pRasterizationState = nullptr;
+		}
+		if (!fragmentShader) {
+			pipelineInfo.pDepthStencilState = nullptr;
+		}
+		if (!fragmentShader && !fragmentOutput) {
+			pipelineInfo.pMultisampleState = nullptr;
+		}
+		if (!fragmentOutput) {
+			pipelineInfo.pColorBlendState = nullptr;
+		}
+		if (!preRasterization && !fragmentShader) {
+			pipelineInfo.layout = VK_NULL_HANDLE;
+		}
 	}
+	pipelineInfo.stageCount = endStage - firstStage;
+	pipelineInfo.pStages = pipelineInfo.stageCount > 0 ? shaderStages.data() + firstStage : nullptr;
 
-	// Clean up shader modules
-	vkDestroyShaderModule(device, vertexShaderModule, nullptr);
-	vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+	return pipeline;
 }
 
 void DefaultPipeline::destroy(LibGFX::VkContext& context)
@@ -188,11 +471,52 @@ void DefaultPipeline::destroy(LibGFX::VkContext& context)
 	context.destroyDescriptorSetLayout(m_uniformsLayout);
 	context.destroyDescriptorSetLayout(m_textureLayout);
 
-	// Destroy pipeline and pipeline layout
-	vkDestroyPipeline(device, m_pipeline, nullptr);
+	// Stop the optimized builds, then destroy all variants, the libraries they were linked from, the
+	// shader modules and the pipeline layout
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+	for (auto& variant : m_optimized) {
+		vkDestroyPipeline(device, variant.second, nullptr);
+	}
+	m_optimized.clear();
+	for (auto& variant : m_variants) {
+		vkDestroyPipeline(device, variant.second, nullptr);
+	}
+	m_variants.clear();
+	for (auto& library : m_libraries) {
+		vkDestroyPipeline(device, library.second, nullptr);
+	}
+	m_libraries.clear();
+	m_pipeline = VK_NULL_HANDLE;
+	vkDestroyShaderModule(device, m_vertexShader, nullptr);
+	vkDestroyShaderModule(device, m_fragmentShader, nullptr);
 	vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
 }
 
+void DefaultPipeline::pushTexture(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler) const
+{
+	// Written straight into the command buffer, no pool and no set allocation
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstBinding = 0;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	m_cmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, 1, &write);
+}
+
 VkPipeline DefaultPipeline::getPipeline() const
 {
 	return m_pipeline;
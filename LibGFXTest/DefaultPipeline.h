@@ -2,7 +2,44 @@
 #include "Pipeline.h"
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <unordered_map>
+#include <array>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
 #include "VkContext.h"
+#include "DeletionQueue.h"
+
+// Fixed function state that differs between the passes, every combination is one cached pipeline
+struct PipelineState
+{
+	bool blend = false;
+	bool depthWrite = true;
+	VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+	bool depthOnly = false;		// Vertex stage only, no color writes
+
+	// Shader features, specialization constants of the fragment shader
+	bool texture = true;		// Sample the bound texture
+	bool vertexColor = true;	// Multiply by the vertex color
+	bool alphaTest = false;		// Discard fragments below the alpha cutoff
+
+	uint32_t getKey() const
+	{
+		return (blend ? 1u : 0u) | (depthWrite ? 2u : 0u) | (depthOnly ? 4u : 0u) | (static_cast<uint32_t>(depthCompare) << 3)
+			| (texture ? 1u << 6 : 0u) | (vertexColor ? 1u << 7 : 0u) | (alphaTest ? 1u << 8 : 0u);
+	}
+
+	// Blending off, depth test and write
+	static PipelineState opaque() { return PipelineState(); }
+	// Lays down the depth of the opaque geometry before it is shaded
+	static PipelineState depthPrepass() { PipelineState state; state.depthOnly = true; return state; }
+	// Opaque draws after a prepass, only the visible fragment of each pixel passes
+	static PipelineState opaqueAfterPrepass() { PipelineState state; state.depthWrite = false; state.depthCompare = VK_COMPARE_OP_EQUAL; return state; }
+	// Alpha blended, tested against the opaque depth but not written
+	static PipelineState transparent() { PipelineState state; state.blend = true; state.depthWrite = false; return state; }
+};
 
 class DefaultPipeline : public LibGFX::Pipeline
 {
@@ -11,17 +48,77 @@ private:
 	VkPipelineLayout m_pipelineLayout;
 	VkDescriptorSetLayout m_uniformsLayout;
 	VkDescriptorSetLayout m_textureLayout;
+	VkShaderModule m_vertexShader = VK_NULL_HANDLE;
+	VkShaderModule m_fragmentShader = VK_NULL_HANDLE;
+	std::unordered_map<uint32_t, VkPipeline> m_variants;
+	std::unordered_map<uint64_t, VkPipeline> m_libraries;
 	VkViewport m_viewport;
 	VkRect2D m_scissor;
-	VkRenderPass m_renderPass;
+	VkRenderPass m_renderPass = VK_NULL_HANDLE;
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED;
+	VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+	VkSampleCountFlagBits m_samples = VK_SAMPLE_COUNT_1_BIT;
+	VkSampler m_immutableSampler = VK_NULL_HANDLE;
+	bool m_pushDescriptors = false;
+	bool m_descriptorBuffers = false;
+	PFN_vkCmdPushDescriptorSetKHR m_cmdPushDescriptorSet = nullptr;
+
+	// Link time optimized builds of fast linked variants, made by the worker
+	struct OptimizeJob
+	{
+		uint32_t key;
+		std::array<VkPipeline, 4> libraries;
+	};
+
+	bool m_pipelineLibraries = false;
+	bool m_fastLinking = false;
+	VkDevice m_device = VK_NULL_HANDLE;
+	std::mutex m_mutex;
+	std::thread m_worker;
+	std::condition_variable m_wake;
+	std::deque<OptimizeJob> m_jobs;
+	std::vector<std::pair<uint32_t, VkPipeline>> m_optimized;
+	bool m_stop = false;
+
+	// Complete pipeline when libraryParts is 0, otherwise a library of the given parts
+	VkPipeline createPipeline(VkDevice device, const PipelineState& state, VkGraphicsPipelineLibraryFlagsEXT libraryParts) const;
+	VkPipeline getLibrary(VkDevice device, const PipelineState& state, VkGraphicsPipelineLibraryFlagsEXT part);
+	VkPipeline linkLibraries(VkDevice device, const std::array<VkPipeline, 4>& libraries, bool optimized) const;
+	void workerLoop();
 
 public:
 	void setViewport(VkViewport viewport) { m_viewport = viewport; }
 	void setScissor(VkRect2D scissor) { m_scissor = scissor; }
 	void setRenderPass(VkRenderPass renderPass) { m_renderPass = renderPass; }
+	// Attachment formats for dynamic rendering, used when no render pass is set
+	void setRenderingFormats(VkFormat colorFormat, VkFormat depthFormat) { m_colorFormat = colorFormat; m_depthFormat = depthFormat; }
+	// Sample count of the attachments the pipeline renders into
+	void setSampleCount(VkSampleCountFlagBits samples) { m_samples = samples; }
+	// Baked into the texture layout, set before create. The sampler has to outlive the pipeline.
+	void setImmutableSampler(VkSampler sampler) { m_immutableSampler = sampler; }
+	// Textures are pushed per draw instead of bound as sets, needs VK_KHR_push_descriptor enabled on the device,
+	// pass DeviceFeatures::pushDescriptor.
+	void setPushDescriptors(bool enable) { m_pushDescriptors = enable; }
+	bool usesPushDescriptors() const { return m_pushDescriptors; }
+	void pushTexture(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler) const;
+	// Both layouts live in a descriptor buffer (see DescriptorBuffer), needs VK_EXT_descriptor_buffer enabled on the device,
+	// pass DescriptorBuffer::isSupported. Takes precedence over push descriptors.
+	void setDescriptorBuffers(bool enable) { m_descriptorBuffers = enable; }
+	bool usesDescriptorBuffers() const { return m_descriptorBuffers; }
+	// Variants are linked from separately compiled parts (vertex input, pre-rasterization, fragment shader,
+	// fragment output), optimized builds run in the background. Needs VK_EXT_graphics_pipeline_library enabled on the device,
+	// pass DeviceFeatures::graphicsPipelineLibrary.
+	void setPipelineLibraries(bool enable) { m_pipelineLibraries = enable; }
+	bool usesPipelineLibraries() const { return m_pipelineLibraries; }
 	void create(LibGFX::VkContext& context);
 	void destroy(LibGFX::VkContext& context);
+	// Opaque variant
 	VkPipeline getPipeline() const override;
+	// Pipeline for the given state, created on first use and destroyed with the pipeline
+	VkPipeline getVariant(LibGFX::VkContext& context, const PipelineState& state);
+	// Swaps in variants whose optimized build finished, the fast linked ones are destroyed after lastValue.
+	// Call before recording, handles from getVariant are only valid until the next call.
+	void updateVariants(DeletionQueue& deletionQueue, uint64_t lastValue);
 	VkPipelineLayout getPipelineLayout() const override;
 	VkDescriptorSetLayout getUniformsLayout() const { return m_uniformsLayout; }
 	VkDescriptorSetLayout getTextureLayout() const { return m_textureLayout; }
@@ -0,0 +1,72 @@
+#include "DeletionQueue.h"
+#include <utility>
+#include <algorithm>
+
+void DeletionQueue::enqueue(uint64_t value, std::function<void(LibGFX::VkContext&)> destroy)
+{
+	// Callers tag with either the pending frame value or the last submitted one, so a
+	// later request can carry a lower value. Insert sorted so collect can stop at the
+	// first entry still in flight, equal values keep their request order.
+	auto it = std::upper_bound(m_entries.begin(), m_entries.end(), value,
+		[](uint64_t v, const Entry& entry) { return v < entry.value; });
+	m_entries.insert(it, { value, std::move(destroy) });
+}
+
+void DeletionQueue::destroyBuffer(uint64_t value, LibGFX::Buffer buffer)
+{
+	enqueue(value, [buffer](LibGFX::VkContext& context) mutable {
+		context.destroyBuffer(buffer);
+	});
+}
+
+void DeletionQueue::destroyImage(uint64_t value, LibGFX::Image image)
+{
+	enqueue(value, [image](LibGFX::VkContext& context) mutable {
+		context.destroyImage(image);
+	});
+}
+
+void DeletionQueue::destroyTexture(uint64_t value, Texture texture)
+{
+	enqueue(value, [texture](LibGFX::VkContext& context) mutable {
+		::destroyTexture(context, texture);
+	});
+}
+
+void DeletionQueue::destroyImageView(uint64_t value, VkImageView imageView)
+{
+	enqueue(value, [imageView](LibGFX::VkContext& context) {
+		vkDestroyImageView(context.getDevice(), imageView, nullptr);
+	});
+}
+
+void DeletionQueue::destroySampler(uint64_t value, VkSampler sampler)
+{
+	enqueue(value, [sampler](LibGFX::VkContext& context) {
+		context.destroySampler(sampler);
+	});
+}
+
+void DeletionQueue::destroyDescriptorSetPool(uint64_t value, VkDescriptorPool descriptorPool)
+{
+	enqueue(value, [descriptorPool](LibGFX::VkContext& context) {
+		context.destroyDescriptorSetPool(descriptorPool);
+	});
+}
+
+void DeletionQueue::collect(LibGFX::VkContext& context, uint64_t completedValue)
+{
+	while (!m_entries.empty() && m_entries.front().value <= completedValue) {
+		m_entries.front().destroy(context);
+		m_entries.pop_front();
+	}
+}
+
+void DeletionQueue::flush(LibGFX::VkContext& context)
+{
+	// Only valid once the device is idle
+	for (auto& entry : m_entries) {
+		entry.destroy(context);
+	}
+	m_entries.clear();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include "VkContext.h"
+#include "Imaging.h"
+#include "Texture.h"
+
+// Deferred destruction of GPU resources. Every request is tagged with the
+// frame timeline value of the last submit that may still use the resource
+// and runs once the GPU has passed that value, without idling the device.
+class DeletionQueue
+{
+private:
+	struct Entry
+	{
+		uint64_t value;
+		std::function<void(LibGFX::VkContext&)> destroy;
+	};
+
+	std::deque<Entry> m_entries;
+
+public:
+	void enqueue(uint64_t value, std::function<void(LibGFX::VkContext&)> destroy);
+	void destroyBuffer(uint64_t value, LibGFX::Buffer buffer);
+	void destroyImage(uint64_t value, LibGFX::Image image);
+	void destroyTexture(uint64_t value, Texture texture);
+	void destroyImageView(uint64_t value, VkImageView imageView);
+	void destroySampler(uint64_t value, VkSampler sampler);
+	void destroyDescriptorSetPool(uint64_t value, VkDescriptorPool descriptorPool);
+	void collect(LibGFX::VkContext& context, uint64_t completedValue);
+	void flush(LibGFX::VkContext& context);
+	size_t size() const { return m_entries.size(); }
+};
@@ -0,0 +1,204 @@
+// DescriptorBenchmark.cpp: CPU cost of writing and binding descriptors.
+//
+// Writes the uniform buffer binding of 10000 descriptor sets with vkUpdateDescriptorSets
+// and with descriptor update templates (see DescriptorUpdateTemplate), then binds each of
+// them once while recording a command buffer. Where the device enabled VK_EXT_descriptor_buffer
+// the same is done with sets in a descriptor buffer (see DescriptorBuffer). Prints the
+// best time per set over a number of runs.
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include "LibGFX.h"
+#include "VkContext.h"
+#include "DescriptorSetLayoutBuilder.h"
+#include "DescriptorPoolBuilder.h"
+#include "DescriptorUpdateTemplate.h"
+#include "DescriptorBuffer.h"
+#include "DeletionQueue.h"
+#include "DeviceFeatures.h"
+
+static constexpr uint32_t SetCount = 10000;
+static constexpr uint32_t Runs = 20;
+
+// Best run in nanoseconds per set, the first runs warm up the caches and the driver
+static double measure(const std::function<void()>& run)
+{
+	double best = 1e30;
+	for (uint32_t i = 0; i < Runs; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best / SetCount;
+}
+
+static void report(const char* name, double nanoseconds)
+{
+	std::cout << name << ": " << nanoseconds << " ns per set" << std::endl;
+}
+
+static VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout layout)
+{
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &layout;
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+	return pipelineLayout;
+}
+
+// Records one bind per set, the commands are never submitted
+static double measureBinds(LibGFX::VkContext& context, VkCommandBuffer commandBuffer, const std::function<void(uint32_t)>& bind)
+{
+	return measure([&]() {
+		context.beginCommandBuffer(commandBuffer);
+		for (uint32_t i = 0; i < SetCount; i++) {
+			bind(i);
+		}
+		context.endCommandBuffer(commandBuffer);
+	});
+}
+
+int main()
+{
+	// Validation stays off, the layers would dominate the timings
+	auto window = LibGFX::GFX::createWindow(320, 240, "Descriptor Benchmark");
+	auto context = LibGFX::GFX::createContext(window);
+	context->initialize(LibGFX::VkContext::defaultAppInfo(), false);
+	VkDevice device = context->getDevice();
+
+	// The context enables neither buffer device addresses nor VK_EXT_descriptor_buffer
+	DeviceFeatures deviceFeatures;
+	deviceFeatures.bufferDeviceAddress = false;
+	deviceFeatures.descriptorBuffer = false;
+	deviceFeatures.restrictToSupported(*context);
+
+	// One uniform buffer binding per set, all sets reference the same buffer
+	LibGFX::Buffer uniformBuffer = context->createBuffer(256, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	LibGFX::DescriptorSetLayoutBuilder layoutBuilder;
+	VkDescriptorSetLayout layout = layoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1)
+		.build(*context);
+
+	LibGFX::DescriptorPoolBuilder poolBuilder;
+	poolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SetCount);
+	poolBuilder.setMaxSets(SetCount);
+	VkDescriptorPool pool = poolBuilder.build(*context);
+	std::vector<VkDescriptorSet> sets(SetCount);
+	for (auto& set : sets) {
+		set = context->allocateDescriptorSet(pool, layout);
+	}
+	std::vector<VkDescriptorBufferInfo> bufferInfos(SetCount, { uniformBuffer.buffer, 0, uniformBuffer.size });
+
+	// One VkWriteDescriptorSet per set, once as a call per set and once as a single call.
+	// The write array is rebuilt every run, as a renderer would per frame.
+	std::vector<VkWriteDescriptorSet> writes(SetCount);
+	auto buildWrites = [&]() {
+		for (uint32_t i = 0; i < SetCount; i++) {
+			writes[i] = {};
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[i];
+			writes[i].dstBinding = 0;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+	};
+	report("vkUpdateDescriptorSets, one call per set", measure([&]() {
+		buildWrites();
+		for (const auto& write : writes) {
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		}
+	}));
+	report("vkUpdateDescriptorSets, one call", measure([&]() {
+		buildWrites();
+		vkUpdateDescriptorSets(device, SetCount, writes.data(), 0, nullptr);
+	}));
+
+	// The template reads the buffer info straight from the packed array
+	DescriptorUpdateTemplate updateTemplate;
+	updateTemplate.addEntry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0).create(*context, layout);
+	report("Update template, one update per set", measure([&]() {
+		for (uint32_t i = 0; i < SetCount; i++) {
+			updateTemplate.update(*context, sets[i], bufferInfos[i]);
+		}
+	}));
+	report("Update template, batched", measure([&]() {
+		updateTemplate.update(*context, sets, bufferInfos);
+	}));
+
+	// Binding cost while recording, one set per draw
+	auto queueFamilyIndices = context->getQueueFamilyIndices(context->getPhysicalDevice());
+	VkCommandPool commandPool = context->createCommandPool(queueFamilyIndices.graphicsFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VkCommandBuffer commandBuffer = context->allocateCommandBuffers(commandPool, 1)[0];
+	VkPipelineLayout pipelineLayout = createPipelineLayout(device, layout);
+	report("vkCmdBindDescriptorSets", measureBinds(*context, commandBuffer, [&](uint32_t i) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &sets[i], 0, nullptr);
+	}));
+
+	// The same sets in a descriptor buffer, written with vkGetDescriptorEXT and selected by offset
+	if (DescriptorBuffer::isSupported(*context, deviceFeatures)) {
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+		VkDescriptorSetLayout bufferLayout;
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &bufferLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		VkPipelineLayout bufferPipelineLayout = createPipelineLayout(device, bufferLayout);
+
+		LibGFX::Buffer addressableBuffer = DescriptorBuffer::createAddressableBuffer(*context, 256, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+		DescriptorBuffer descriptorBuffer;
+		descriptorBuffer.create(*context, DescriptorBuffer::getSetStride(*context, bufferLayout) * SetCount);
+		std::vector<std::vector<VkDeviceSize>> offsets(SetCount);
+		for (auto& offset : offsets) {
+			offset.push_back(descriptorBuffer.allocate(*context, bufferLayout));
+		}
+
+		report("Descriptor buffer, one write per set", measure([&]() {
+			for (uint32_t i = 0; i < SetCount; i++) {
+				descriptorBuffer.writeBuffer(*context, offsets[i][0], bufferLayout, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, addressableBuffer);
+			}
+		}));
+		report("Descriptor buffer, vkCmdSetDescriptorBufferOffsetsEXT", measureBinds(*context, commandBuffer, [&](uint32_t i) {
+			if (i == 0) {
+				descriptorBuffer.bind(commandBuffer);
+			}
+			descriptorBuffer.setOffsets(commandBuffer, bufferPipelineLayout, 0, offsets[i]);
+		}));
+
+		DeletionQueue deletionQueue;
+		descriptorBuffer.destroy(deletionQueue, 0);
+		deletionQueue.flush(*context);
+		context->destroyBuffer(addressableBuffer);
+		vkDestroyPipelineLayout(device, bufferPipelineLayout, nullptr);
+		context->destroyDescriptorSetLayout(bufferLayout);
+	}
+	else {
+		std::cout << "Descriptor buffers are not enabled on the device, skipped" << std::endl;
+	}
+
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	context->freeCommandBuffer(commandPool, commandBuffer);
+	context->destroyCommandPool(commandPool);
+	updateTemplate.destroy(*context);
+	context->destroyDescriptorSetPool(pool);
+	context->destroyDescriptorSetLayout(layout);
+	context->destroyBuffer(uniformBuffer);
+	context->dispose();
+	return 0;
+}
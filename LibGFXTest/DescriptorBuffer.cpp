@@ -0,0 +1,228 @@
+#include "DescriptorBuffer.h"
+#include "Texture.h"
+#include <stdexcept>
+
+bool DescriptorBuffer::isSupported(LibGFX::VkContext& context, const DeviceFeatures& features)
+{
+	// Some drivers resolve entry points of extensions that were not enabled, the flags decide
+	return features.descriptorBuffer && features.bufferDeviceAddress &&
+		vkGetDeviceProcAddr(context.getDevice(), "vkGetDescriptorEXT") != nullptr;
+}
+
+VkDeviceSize DescriptorBuffer::getSetStride(LibGFX::VkContext& context, VkDescriptorSetLayout layout)
+{
+	auto getLayoutSize = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(context.getDevice(), "vkGetDescriptorSetLayoutSizeEXT"));
+	if (!getLayoutSize) {
+		throw std::runtime_error("descriptor buffers are not supported by the device!");
+	}
+	VkDeviceSize layoutSize = 0;
+	getLayoutSize(context.getDevice(), layout, &layoutSize);
+
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorProperties = {};
+	descriptorProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &descriptorProperties;
+	vkGetPhysicalDeviceProperties2(context.getPhysicalDevice(), &properties);
+	VkDeviceSize alignment = descriptorProperties.descriptorBufferOffsetAlignment;
+	return (layoutSize + alignment - 1) / alignment * alignment;
+}
+
+LibGFX::Buffer DescriptorBuffer::createAddressableBuffer(LibGFX::VkContext& context, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	VkDevice device = context.getDevice();
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	LibGFX::Buffer buffer;
+	buffer.size = size;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create buffer!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements);
+
+	// The memory has to be allocated with the device address flag as well
+	VkMemoryAllocateFlagsInfo allocFlags = {};
+	allocFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	allocFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = &allocFlags;
+	allocInfo.allocationSize = memoryRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS) {
+		vkDestroyBuffer(device, buffer.buffer, nullptr);
+		throw std::runtime_error("failed to allocate buffer memory!");
+	}
+	vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+	return buffer;
+}
+
+void DescriptorBuffer::create(LibGFX::VkContext& context, VkDeviceSize size)
+{
+	VkDevice device = context.getDevice();
+	m_getLayoutSize = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT"));
+	m_getBindingOffset = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+	m_getDescriptor = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorEXT"));
+	m_cmdBindDescriptorBuffers = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT"));
+	m_cmdSetDescriptorBufferOffsets = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+	if (!m_getLayoutSize || !m_getBindingOffset || !m_getDescriptor || !m_cmdBindDescriptorBuffers || !m_cmdSetDescriptorBufferOffsets) {
+		throw std::runtime_error("descriptor buffers are not supported by the device!");
+	}
+
+	// Descriptor sizes and the set offset alignment are implementation defined
+	m_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &m_properties;
+	vkGetPhysicalDeviceProperties2(context.getPhysicalDevice(), &properties);
+
+	// Combined image samplers need a buffer that holds sampler and resource descriptors
+	m_buffer = createAddressableBuffer(context, size,
+		VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT);
+
+	void* mapped = nullptr;
+	if (vkMapMemory(device, m_buffer.memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map descriptor buffer!");
+	}
+	m_mapped = static_cast<uint8_t*>(mapped);
+
+	VkBufferDeviceAddressInfo addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.buffer = m_buffer.buffer;
+	m_address = vkGetBufferDeviceAddress(device, &addressInfo);
+	m_used = 0;
+}
+
+void DescriptorBuffer::destroy(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	// Freeing the memory unmaps it
+	if (m_buffer.buffer != VK_NULL_HANDLE) {
+		deletionQueue.destroyBuffer(lastValue, m_buffer);
+	}
+	m_buffer = LibGFX::Buffer();
+	m_mapped = nullptr;
+	m_address = 0;
+	m_used = 0;
+}
+
+VkDeviceSize DescriptorBuffer::allocate(LibGFX::VkContext& context, VkDescriptorSetLayout layout)
+{
+	VkDeviceSize layoutSize = 0;
+	m_getLayoutSize(context.getDevice(), layout, &layoutSize);
+
+	// Set offsets must be aligned, sets are never freed individually
+	VkDeviceSize alignment = m_properties.descriptorBufferOffsetAlignment;
+	VkDeviceSize offset = (m_used + alignment - 1) / alignment * alignment;
+	if (offset + layoutSize > m_buffer.size) {
+		throw std::runtime_error("descriptor buffer is full!");
+	}
+	m_used = offset + layoutSize;
+	return offset;
+}
+
+size_t DescriptorBuffer::getDescriptorSize(VkDescriptorType type) const
+{
+	switch (type) {
+	case VK_DESCRIPTOR_TYPE_SAMPLER:
+		return m_properties.samplerDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		return m_properties.combinedImageSamplerDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		return m_properties.sampledImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		return m_properties.storageImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		return m_properties.uniformBufferDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		return m_properties.storageBufferDescriptorSize;
+	default:
+		throw std::runtime_error("descriptor type is not supported by the descriptor buffer!");
+	}
+}
+
+void DescriptorBuffer::writeDescriptor(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, const VkDescriptorGetInfoEXT& getInfo)
+{
+	VkDevice device = context.getDevice();
+	VkDeviceSize bindingOffset = 0;
+	m_getBindingOffset(device, layout, binding, &bindingOffset);
+	m_getDescriptor(device, &getInfo, getDescriptorSize(getInfo.type), m_mapped + setOffset + bindingOffset);
+}
+
+void DescriptorBuffer::writeBuffer(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, const LibGFX::Buffer& buffer)
+{
+	// The buffer has to be created through createAddressableBuffer
+	VkBufferDeviceAddressInfo bufferAddressInfo = {};
+	bufferAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	bufferAddressInfo.buffer = buffer.buffer;
+
+	VkDescriptorAddressInfoEXT addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+	addressInfo.address = vkGetBufferDeviceAddress(context.getDevice(), &bufferAddressInfo);
+	addressInfo.range = buffer.size;
+	addressInfo.format = VK_FORMAT_UNDEFINED;
+
+	VkDescriptorGetInfoEXT getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+	getInfo.type = type;
+	if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+		getInfo.data.pStorageBuffer = &addressInfo;
+	}
+	else {
+		getInfo.data.pUniformBuffer = &addressInfo;
+	}
+	writeDescriptor(context, setOffset, layout, binding, getInfo);
+}
+
+void DescriptorBuffer::writeImage(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout)
+{
+	// Immutable samplers are not taken from the layout, pass the same sampler here
+	VkDescriptorImageInfo imageInfo = { sampler, imageView, imageLayout };
+
+	VkDescriptorGetInfoEXT getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+	getInfo.type = type;
+	switch (type) {
+	case VK_DESCRIPTOR_TYPE_SAMPLER:
+		getInfo.data.pSampler = &sampler;
+		break;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		getInfo.data.pSampledImage = &imageInfo;
+		break;
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		getInfo.data.pStorageImage = &imageInfo;
+		break;
+	default:
+		getInfo.data.pCombinedImageSampler = &imageInfo;
+		break;
+	}
+	writeDescriptor(context, setOffset, layout, binding, getInfo);
+}
+
+void DescriptorBuffer::bind(VkCommandBuffer commandBuffer) const
+{
+	VkDescriptorBufferBindingInfoEXT bindingInfo = {};
+	bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+	bindingInfo.address = m_address;
+	bindingInfo.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+	m_cmdBindDescriptorBuffers(commandBuffer, 1, &bindingInfo);
+}
+
+void DescriptorBuffer::setOffsets(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet, const std::vector<VkDeviceSize>& offsets) const
+{
+	// Every set lives in the one bound buffer, the indices come from a constant table so recording allocates nothing
+	static const uint32_t bufferIndices[8] = {};
+	if (offsets.size() > 8) {
+		throw std::runtime_error("too many descriptor buffer sets in one call!");
+	}
+	m_cmdSetDescriptorBufferOffsets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet,
+		static_cast<uint32_t>(offsets.size()), bufferIndices, offsets.data());
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "VkContext.h"
+#include "DeletionQueue.h"
+#include "DeviceFeatures.h"
+
+// Descriptor sets living in a persistently mapped buffer (VK_EXT_descriptor_buffer).
+// A set is a range of the buffer sized by its layout, descriptors are written straight
+// into it with vkGetDescriptorEXT and the sets of a draw are selected by offset, no pools
+// or vkUpdateDescriptorSets. Layouts and pipelines must be created with the descriptor
+// buffer flags (see DefaultPipeline::setDescriptorBuffers).
+class DescriptorBuffer
+{
+private:
+	LibGFX::Buffer m_buffer;
+	uint8_t* m_mapped = nullptr;
+	VkDeviceAddress m_address = 0;
+	VkDeviceSize m_used = 0;
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT m_properties = {};
+
+	PFN_vkGetDescriptorSetLayoutSizeEXT m_getLayoutSize = nullptr;
+	PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_getBindingOffset = nullptr;
+	PFN_vkGetDescriptorEXT m_getDescriptor = nullptr;
+	PFN_vkCmdBindDescriptorBuffersEXT m_cmdBindDescriptorBuffers = nullptr;
+	PFN_vkCmdSetDescriptorBufferOffsetsEXT m_cmdSetDescriptorBufferOffsets = nullptr;
+
+	size_t getDescriptorSize(VkDescriptorType type) const;
+	void writeDescriptor(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, const VkDescriptorGetInfoEXT& getInfo);
+
+public:
+	// True when the device was created with VK_EXT_descriptor_buffer and buffer device addresses enabled
+	static bool isSupported(LibGFX::VkContext& context, const DeviceFeatures& features);
+	// Bytes one set of the layout takes up in the buffer, including the alignment of the next set
+	static VkDeviceSize getSetStride(LibGFX::VkContext& context, VkDescriptorSetLayout layout);
+	// Host visible buffer with a device address, descriptors reference buffers by address
+	static LibGFX::Buffer createAddressableBuffer(LibGFX::VkContext& context, VkDeviceSize size, VkBufferUsageFlags usage);
+
+	void create(LibGFX::VkContext& context, VkDeviceSize size);
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastValue);
+	VkDeviceSize allocate(LibGFX::VkContext& context, VkDescriptorSetLayout layout);
+	void writeBuffer(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, const LibGFX::Buffer& buffer);
+	void writeImage(LibGFX::VkContext& context, VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
+	void bind(VkCommandBuffer commandBuffer) const;
+	// At most 8 sets per call
+	void setOffsets(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet, const std::vector<VkDeviceSize>& offsets) const;
+	bool isCreated() const { return m_mapped != nullptr; }
+	VkDeviceSize getUsedSize() const { return m_used; }
+};
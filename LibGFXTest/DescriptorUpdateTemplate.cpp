@@ -0,0 +1,72 @@
+#include "DescriptorUpdateTemplate.h"
+#include <stdexcept>
+
+DescriptorUpdateTemplate& DescriptorUpdateTemplate::addEntry(uint32_t binding, VkDescriptorType type, size_t offset, uint32_t count, size_t stride, uint32_t arrayElement)
+{
+	// Array elements default to tightly packed infos of the descriptor type
+	if (stride == 0) {
+		switch (type) {
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			stride = sizeof(VkDescriptorImageInfo);
+			break;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			stride = sizeof(VkBufferView);
+			break;
+		default:
+			stride = sizeof(VkDescriptorBufferInfo);
+			break;
+		}
+	}
+
+	VkDescriptorUpdateTemplateEntry entry = {};
+	entry.dstBinding = binding;
+	entry.dstArrayElement = arrayElement;
+	entry.descriptorCount = count;
+	entry.descriptorType = type;
+	entry.offset = offset;
+	entry.stride = stride;
+	m_entries.push_back(entry);
+	return *this;
+}
+
+void DescriptorUpdateTemplate::create(LibGFX::VkContext& context, VkDescriptorSetLayout layout)
+{
+	VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+	templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(m_entries.size());
+	templateInfo.pDescriptorUpdateEntries = m_entries.data();
+	templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	templateInfo.descriptorSetLayout = layout;
+
+	if (vkCreateDescriptorUpdateTemplate(context.getDevice(), &templateInfo, nullptr, &m_template) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor update template!");
+	}
+}
+
+void DescriptorUpdateTemplate::destroy(LibGFX::VkContext& context)
+{
+	vkDestroyDescriptorUpdateTemplate(context.getDevice(), m_template, nullptr);
+	m_template = VK_NULL_HANDLE;
+	m_entries.clear();
+}
+
+void DescriptorUpdateTemplate::update(LibGFX::VkContext& context, VkDescriptorSet descriptorSet, const void* data) const
+{
+	vkUpdateDescriptorSetWithTemplate(context.getDevice(), descriptorSet, m_template, data);
+}
+
+void DescriptorUpdateTemplate::update(LibGFX::VkContext& context, const VkDescriptorSet* descriptorSets, uint32_t count, const void* data, size_t dataStride) const
+{
+	// Vulkan has no multi set template call, the batch walks an array of structs with the
+	// device and template resolved once
+	VkDevice device = context.getDevice();
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (uint32_t i = 0; i < count; i++) {
+		vkUpdateDescriptorSetWithTemplate(device, descriptorSets[i], m_template, bytes + i * dataStride);
+	}
+}
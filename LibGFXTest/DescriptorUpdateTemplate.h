@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "VkContext.h"
+
+// Descriptor set updates through a VkDescriptorUpdateTemplate. Entries describe
+// where the buffer and image infos of each binding sit in a packed POD struct,
+// the template is created once per layout and every update is one call that
+// reads the struct, no VkWriteDescriptorSet arrays are built per set.
+class DescriptorUpdateTemplate
+{
+private:
+	VkDescriptorUpdateTemplate m_template = VK_NULL_HANDLE;
+	std::vector<VkDescriptorUpdateTemplateEntry> m_entries;
+
+public:
+	DescriptorUpdateTemplate& addEntry(uint32_t binding, VkDescriptorType type, size_t offset, uint32_t count = 1, size_t stride = 0, uint32_t arrayElement = 0);
+	void create(LibGFX::VkContext& context, VkDescriptorSetLayout layout);
+	void destroy(LibGFX::VkContext& context);
+	void update(LibGFX::VkContext& context, VkDescriptorSet descriptorSet, const void* data) const;
+	void update(LibGFX::VkContext& context, const VkDescriptorSet* descriptorSets, uint32_t count, const void* data, size_t dataStride) const;
+
+	template<typename T>
+	void update(LibGFX::VkContext& context, VkDescriptorSet descriptorSet, const T& data) const { update(context, descriptorSet, static_cast<const void*>(&data)); }
+
+	template<typename T>
+	void update(LibGFX::VkContext& context, const std::vector<VkDescriptorSet>& descriptorSets, const std::vector<T>& data) const
+	{
+		update(context, descriptorSets.data(), static_cast<uint32_t>(std::min(descriptorSets.size(), data.size())), data.data(), sizeof(T));
+	}
+};
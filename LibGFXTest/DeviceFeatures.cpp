@@ -0,0 +1,75 @@
+#include "DeviceFeatures.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+static bool hasExtension(const std::vector<VkExtensionProperties>& extensions, const char* name)
+{
+	return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) {
+		return std::strcmp(extension.extensionName, name) == 0;
+	});
+}
+
+void DeviceFeatures::restrictToSupported(LibGFX::VkContext& context)
+{
+	VkPhysicalDevice physicalDevice = context.getPhysicalDevice();
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	// The per version feature blocks may only be chained on devices of that version,
+	// older devices report the features through their extensions
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceVulkan13Features features13 = {};
+	features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	if (properties.apiVersion >= VK_API_VERSION_1_2) {
+		features.pNext = &features12;
+	}
+	if (properties.apiVersion >= VK_API_VERSION_1_3) {
+		features12.pNext = &features13;
+	}
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures = {};
+	libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	bool libraryExtension = hasExtension(extensions, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+	if (libraryExtension) {
+		libraryFeatures.pNext = features.pNext;
+		features.pNext = &libraryFeatures;
+	}
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+	descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+	bool descriptorBufferExtension = hasExtension(extensions, VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+	if (descriptorBufferExtension) {
+		descriptorBufferFeatures.pNext = features.pNext;
+		features.pNext = &descriptorBufferFeatures;
+	}
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	timelineSemaphore = timelineSemaphore && (properties.apiVersion >= VK_API_VERSION_1_2
+		? features12.timelineSemaphore == VK_TRUE : hasExtension(extensions, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME));
+	synchronization2 = synchronization2 && (properties.apiVersion >= VK_API_VERSION_1_3
+		? features13.synchronization2 == VK_TRUE : hasExtension(extensions, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME));
+	dynamicRendering = dynamicRendering && (properties.apiVersion >= VK_API_VERSION_1_3
+		? features13.dynamicRendering == VK_TRUE : hasExtension(extensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME));
+	graphicsPipelineLibrary = graphicsPipelineLibrary && libraryExtension && libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+	bufferDeviceAddress = bufferDeviceAddress && (properties.apiVersion >= VK_API_VERSION_1_2
+		? features12.bufferDeviceAddress == VK_TRUE : hasExtension(extensions, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME));
+	descriptorBuffer = descriptorBuffer && bufferDeviceAddress && descriptorBufferExtension && descriptorBufferFeatures.descriptorBuffer == VK_TRUE;
+	pushDescriptor = pushDescriptor && hasExtension(extensions, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+	// The upload family has to exist and support transfers, graphics and compute imply it
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	if (transferFamily != VK_QUEUE_FAMILY_IGNORED && (transferFamily >= familyCount ||
+		(families[transferFamily].queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)) {
+		transferFamily = VK_QUEUE_FAMILY_IGNORED;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include "VkContext.h"
+
+// Features and queues the device was created with. Vulkan cannot report what a device
+// enabled, so the application fills this in to match its context, restrictToSupported
+// then clears what the physical device does not support. Optional code paths check
+// these flags instead of looking up entry points, which resolve for core commands
+// whether or not the feature was enabled.
+struct DeviceFeatures
+{
+	bool timelineSemaphore = false;		// Vulkan 1.2 core, VK_KHR_timeline_semaphore
+	bool synchronization2 = false;		// Vulkan 1.3 core, VK_KHR_synchronization2
+	bool dynamicRendering = false;		// Vulkan 1.3 core, VK_KHR_dynamic_rendering
+	bool graphicsPipelineLibrary = false;	// VK_EXT_graphics_pipeline_library
+	bool bufferDeviceAddress = false;	// Vulkan 1.2 core, VK_KHR_buffer_device_address
+	bool descriptorBuffer = false;		// VK_EXT_descriptor_buffer, needs bufferDeviceAddress
+	bool pushDescriptor = false;		// VK_KHR_push_descriptor
+	uint32_t transferFamily = VK_QUEUE_FAMILY_IGNORED;	// Family of an extra queue for uploads, IGNORED when there is none
+
+	void restrictToSupported(LibGFX::VkContext& context);
+};
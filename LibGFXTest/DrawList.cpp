@@ -0,0 +1,43 @@
+#include "DrawList.h"
+#include <algorithm>
+
+void DrawList::clear()
+{
+	m_opaque.clear();
+	m_transparent.clear();
+}
+
+void DrawList::addOpaque(const Mesh& mesh, float viewDepth)
+{
+	m_opaque.push_back({ &mesh, viewDepth });
+}
+
+void DrawList::addTransparent(const Mesh& mesh, float viewDepth)
+{
+	m_transparent.push_back({ &mesh, viewDepth });
+}
+
+void DrawList::sort()
+{
+	// Stable, draws at the same depth keep their submission order
+	std::stable_sort(m_opaque.begin(), m_opaque.end(), [](const DrawItem& a, const DrawItem& b) {
+		return a.viewDepth < b.viewDepth;
+	});
+	std::stable_sort(m_transparent.begin(), m_transparent.end(), [](const DrawItem& a, const DrawItem& b) {
+		return a.viewDepth > b.viewDepth;
+	});
+}
+
+void DrawList::drawOpaque(VkCommandBuffer commandBuffer, const GeometryBuffer& geometryBuffer) const
+{
+	for (const DrawItem& item : m_opaque) {
+		geometryBuffer.draw(commandBuffer, *item.mesh);
+	}
+}
+
+void DrawList::drawTransparent(VkCommandBuffer commandBuffer, const GeometryBuffer& geometryBuffer) const
+{
+	for (const DrawItem& item : m_transparent) {
+		geometryBuffer.draw(commandBuffer, *item.mesh);
+	}
+}
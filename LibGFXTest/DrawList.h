@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include "GeometryBuffer.h"
+
+// Mesh draw with its distance to the camera along the view direction
+struct DrawItem
+{
+	const Mesh* mesh = nullptr;
+	float viewDepth = 0.0f;
+};
+
+// Draws of a frame split into the opaque and the transparent pass. Opaque draws are
+// sorted front to back so the depth test rejects hidden fragments early, transparent
+// draws back to front so they blend over each other in order.
+class DrawList
+{
+private:
+	std::vector<DrawItem> m_opaque;
+	std::vector<DrawItem> m_transparent;
+
+public:
+	void clear();
+	void addOpaque(const Mesh& mesh, float viewDepth);
+	void addTransparent(const Mesh& mesh, float viewDepth);
+	void sort();
+	void drawOpaque(VkCommandBuffer commandBuffer, const GeometryBuffer& geometryBuffer) const;
+	void drawTransparent(VkCommandBuffer commandBuffer, const GeometryBuffer& geometryBuffer) const;
+	bool hasTransparent() const { return !m_transparent.empty(); }
+};
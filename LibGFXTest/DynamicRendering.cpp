@@ -0,0 +1,168 @@
+#include "DynamicRendering.h"
+#include <stdexcept>
+
+// Core entry point first, the extension alias on Vulkan 1.2 devices
+static PFN_vkVoidFunction getRenderingProcAddr(VkDevice device, const char* name, const char* extensionName)
+{
+	PFN_vkVoidFunction function = vkGetDeviceProcAddr(device, name);
+	return function != nullptr ? function : vkGetDeviceProcAddr(device, extensionName);
+}
+
+bool DynamicRendering::isSupported(LibGFX::VkContext& context, const DeviceFeatures& features)
+{
+	// Core entry points resolve on 1.3 devices even when the feature was not enabled
+	return features.dynamicRendering &&
+		getRenderingProcAddr(context.getDevice(), "vkCmdBeginRendering", "vkCmdBeginRenderingKHR") != nullptr;
+}
+
+VkSampleCountFlagBits DynamicRendering::selectSampleCount(LibGFX::VkContext& context, VkSampleCountFlagBits requested)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &properties);
+	VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+	// Sample count bits are powers of two, step down until one is supported
+	for (uint32_t samples = requested; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+		if ((supported & samples) != 0) {
+			return static_cast<VkSampleCountFlagBits>(samples);
+		}
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+void DynamicRendering::create(LibGFX::VkContext& context, VkSwapchainKHR swapchain, VkFormat colorFormat, VkExtent2D extent, VkFormat depthFormat)
+{
+	VkDevice device = context.getDevice();
+	m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(getRenderingProcAddr(device, "vkCmdBeginRendering", "vkCmdBeginRenderingKHR"));
+	m_cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(getRenderingProcAddr(device, "vkCmdEndRendering", "vkCmdEndRenderingKHR"));
+	if (!m_cmdBeginRendering || !m_cmdEndRendering) {
+		throw std::runtime_error("dynamic rendering is not supported by the device!");
+	}
+	m_colorFormat = colorFormat;
+	m_extent = extent;
+
+	// One color view per swapchain image
+	uint32_t imageCount = 0;
+	vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
+	m_colorImages.resize(imageCount);
+	vkGetSwapchainImagesKHR(device, swapchain, &imageCount, m_colorImages.data());
+
+	for (VkImage image : m_colorImages) {
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = colorFormat;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView imageView;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create swapchain image view!");
+		}
+		m_colorViews.push_back(imageView);
+	}
+
+	// The multisampled color only lives until the resolve at the end of the pass
+	m_config.samples = selectSampleCount(context, m_config.samples);
+	if (m_config.samples != VK_SAMPLE_COUNT_1_BIT) {
+		m_multisampledColor = createAttachment(context, extent.width, extent.height, colorFormat,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, m_config.samples);
+		m_config.colorStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	// The depth image is only written and tested within a frame. A transient image is never stored.
+	VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (m_config.transientDepth) {
+		depthUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		m_config.depthStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+	m_depth = createAttachment(context, extent.width, extent.height, depthFormat, depthUsage, m_config.samples);
+}
+
+void DynamicRendering::destroy(LibGFX::VkContext& context)
+{
+	VkDevice device = context.getDevice();
+	for (VkImageView imageView : m_colorViews) {
+		vkDestroyImageView(device, imageView, nullptr);
+	}
+	m_colorViews.clear();
+	m_colorImages.clear();
+	if (m_depth.image != VK_NULL_HANDLE) {
+		destroyTexture(context, m_depth);
+	}
+	if (m_multisampledColor.image != VK_NULL_HANDLE) {
+		destroyTexture(context, m_multisampledColor);
+	}
+}
+
+void DynamicRendering::begin(VkCommandBuffer commandBuffer, uint32_t imageIndex) const
+{
+	// The attachments were transitioned by the render graph pass this is recorded in
+	bool multisampled = m_multisampledColor.image != VK_NULL_HANDLE;
+
+	VkRenderingAttachmentInfo colorAttachment = {};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	colorAttachment.imageView = m_colorViews[imageIndex];
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = m_config.colorLoadOp;
+	colorAttachment.storeOp = m_config.colorStoreOp;
+	colorAttachment.clearValue.color = m_clearColor;
+	if (multisampled) {
+		// Resolved into the swapchain image within the pass, no separate resolve or blit
+		colorAttachment.imageView = m_multisampledColor.imageView;
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+		colorAttachment.resolveImageView = m_colorViews[imageIndex];
+		colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkRenderingAttachmentInfo depthAttachment = {};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	depthAttachment.imageView = m_depth.imageView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = m_config.depthLoadOp;
+	depthAttachment.storeOp = m_config.depthStoreOp;
+	depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+	VkRenderingInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderingInfo.renderArea = { { 0, 0 }, m_extent };
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+	renderingInfo.pStencilAttachment = hasStencilComponent(m_depth.format) ? &depthAttachment : nullptr;
+	m_cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void DynamicRendering::end(VkCommandBuffer commandBuffer) const
+{
+	m_cmdEndRendering(commandBuffer);
+}
+
+VkDeviceSize DynamicRendering::getAttachmentTraffic() const
+{
+	// Every STORE writes the whole attachment to memory, CLEAR and DONT_CARE stay on chip. A resolve
+	// writes the single sampled swapchain image.
+	VkDeviceSize pixels = static_cast<VkDeviceSize>(m_extent.width) * m_extent.height;
+	VkDeviceSize colorSize = pixels * m_config.samples * getAttachmentFormatSize(m_colorFormat);
+	VkDeviceSize depthSize = pixels * m_config.samples * getAttachmentFormatSize(m_depth.format);
+
+	VkDeviceSize traffic = 0;
+	traffic += m_config.samples != VK_SAMPLE_COUNT_1_BIT ? pixels * getAttachmentFormatSize(m_colorFormat) : 0;
+	traffic += m_config.colorStoreOp == VK_ATTACHMENT_STORE_OP_STORE ? colorSize : 0;
+	traffic += m_config.depthStoreOp == VK_ATTACHMENT_STORE_OP_STORE ? depthSize : 0;
+	return traffic;
+}
+
+VkDeviceSize DynamicRendering::getDepthCommitment(LibGFX::VkContext& context) const
+{
+	if (!isDepthLazilyAllocated()) {
+		return m_depth.size;
+	}
+
+	VkDeviceSize committed = 0;
+	vkGetDeviceMemoryCommitment(context.getDevice(), m_depth.memory, &committed);
+	return committed;
+}
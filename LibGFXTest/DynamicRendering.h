@@ -0,0 +1,75 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "VkContext.h"
+#include "Texture.h"
+#include "DeviceFeatures.h"
+
+// Load and store ops of the attachments. Attachments are not kept across frames, the load ops are
+// CLEAR or DONT_CARE. Nothing reads the depth after the frame, with DONT_CARE and a transient image
+// it stays in tile memory on tile based GPUs and is never written out. With more than one sample
+// color and depth are rendered into transient multisampled images and the color is resolved into
+// the swapchain image at the end of the pass, the store ops then apply to the multisampled images.
+struct AttachmentConfig
+{
+	VkAttachmentLoadOp colorLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	VkAttachmentStoreOp colorStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+	VkAttachmentLoadOp depthLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	VkAttachmentStoreOp depthStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	bool transientDepth = true;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+// Rendering into the swapchain with vkCmdBeginRendering instead of a render pass.
+// The attachments are plain image views of the swapchain images and a depth image
+// owned here, there are no VkRenderPass or VkFramebuffer objects and recreating for
+// a new extent only replaces the views. Pipelines are created with the attachment
+// formats (see DefaultPipeline::setRenderingFormats). No barriers are recorded here,
+// begin and end go into a RenderGraph pass that writes the swapchain image, the depth
+// and the multisampled color, the graph transitions them and hands the swapchain
+// image to the presentation engine.
+class DynamicRendering
+{
+private:
+	PFN_vkCmdBeginRendering m_cmdBeginRendering = nullptr;
+	PFN_vkCmdEndRendering m_cmdEndRendering = nullptr;
+	std::vector<VkImage> m_colorImages;
+	std::vector<VkImageView> m_colorViews;
+	Texture m_depth;
+	Texture m_multisampledColor;
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED;
+	VkExtent2D m_extent = {};
+	VkClearColorValue m_clearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+	AttachmentConfig m_config;
+
+public:
+	// True when the device was created with the dynamicRendering feature and exposes vkCmdBeginRendering
+	// (Vulkan 1.3 or VK_KHR_dynamic_rendering)
+	static bool isSupported(LibGFX::VkContext& context, const DeviceFeatures& features);
+	// Highest sample count up to requested that color and depth attachments support
+	static VkSampleCountFlagBits selectSampleCount(LibGFX::VkContext& context, VkSampleCountFlagBits requested);
+
+	void create(LibGFX::VkContext& context, VkSwapchainKHR swapchain, VkFormat colorFormat, VkExtent2D extent, VkFormat depthFormat);
+	void destroy(LibGFX::VkContext& context);
+	void begin(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+	void end(VkCommandBuffer commandBuffer) const;
+	void setClearColor(VkClearColorValue clearColor) { m_clearColor = clearColor; }
+	// Set before create, transientDepth and samples decide how the attachments are allocated
+	void setAttachmentConfig(const AttachmentConfig& config) { m_config = config; }
+	const AttachmentConfig& getAttachmentConfig() const { return m_config; }
+	// Bytes the attachment store ops and the resolve write to memory each frame
+	VkDeviceSize getAttachmentTraffic() const;
+	// Bytes actually backing the depth image, lazily allocated memory is only committed when used
+	VkDeviceSize getDepthCommitment(LibGFX::VkContext& context) const;
+	bool isDepthLazilyAllocated() const { return (m_depth.memoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0; }
+	uint32_t getImageCount() const { return static_cast<uint32_t>(m_colorImages.size()); }
+	VkImage getColorImage(uint32_t imageIndex) const { return m_colorImages[imageIndex]; }
+	VkImageView getColorView(uint32_t imageIndex) const { return m_colorViews[imageIndex]; }
+	const Texture& getDepth() const { return m_depth; }
+	// Null image with a single sample
+	const Texture& getMultisampledColor() const { return m_multisampledColor; }
+	VkFormat getColorFormat() const { return m_colorFormat; }
+	VkFormat getDepthFormat() const { return m_depth.format; }
+	VkSampleCountFlagBits getSampleCount() const { return m_config.samples; }
+};
@@ -0,0 +1,71 @@
+#include "FrameSync.h"
+#include <stdexcept>
+
+void FrameSync::create(LibGFX::VkContext& context, uint32_t framesInFlight, uint32_t swapchainImageCount)
+{
+	VkSemaphoreTypeCreateInfo typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(context.getDevice(), &semaphoreInfo, nullptr, &m_timeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create frame timeline semaphore!");
+	}
+
+	// Acquire semaphores are per frame slot, present semaphores per swapchain image
+	m_imageAvailableSemaphores = context.createSemaphores(framesInFlight);
+	m_renderFinishedSemaphores = context.createSemaphores(swapchainImageCount);
+	m_slotValues.assign(framesInFlight, 0);
+	m_submittedValue = 0;
+	m_currentFrame = 0;
+}
+
+void FrameSync::destroy(LibGFX::VkContext& context)
+{
+	context.destroySemaphores(m_imageAvailableSemaphores);
+	context.destroySemaphores(m_renderFinishedSemaphores);
+	vkDestroySemaphore(context.getDevice(), m_timeline, nullptr);
+	m_slotValues.clear();
+}
+
+uint32_t FrameSync::beginFrame(LibGFX::VkContext& context)
+{
+	// The slot is reused, wait until the GPU finished the frame that used it last
+	wait(context, m_slotValues[m_currentFrame]);
+	return m_currentFrame;
+}
+
+uint64_t FrameSync::endFrame()
+{
+	// Tag the slot with the value signaled by this frame's submit and advance
+	m_submittedValue++;
+	m_slotValues[m_currentFrame] = m_submittedValue;
+	m_currentFrame = (m_currentFrame + 1) % static_cast<uint32_t>(m_slotValues.size());
+	return m_submittedValue;
+}
+
+void FrameSync::wait(LibGFX::VkContext& context, uint64_t value) const
+{
+	if (value == 0 || getCompletedValue(context) >= value) {
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_timeline;
+	waitInfo.pValues = &value;
+	if (vkWaitSemaphores(context.getDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for frame timeline semaphore!");
+	}
+}
+
+uint64_t FrameSync::getCompletedValue(LibGFX::VkContext& context) const
+{
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(context.getDevice(), m_timeline, &value);
+	return value;
+}
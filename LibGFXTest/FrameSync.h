@@ -0,0 +1,36 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "VkContext.h"
+
+// Frame synchronization on a graphics queue timeline semaphore.
+// Every submit signals the next value of the counter, resources are tagged
+// with that value and the CPU only waits when a frame slot is reused.
+// Binary semaphores remain for swapchain acquire and present, which do not
+// accept timeline semaphores.
+class FrameSync
+{
+private:
+	VkSemaphore m_timeline = VK_NULL_HANDLE;
+	uint64_t m_submittedValue = 0;
+	std::vector<uint64_t> m_slotValues;
+	std::vector<VkSemaphore> m_imageAvailableSemaphores;
+	std::vector<VkSemaphore> m_renderFinishedSemaphores;
+	uint32_t m_currentFrame = 0;
+
+public:
+	void create(LibGFX::VkContext& context, uint32_t framesInFlight, uint32_t swapchainImageCount);
+	void destroy(LibGFX::VkContext& context);
+	uint32_t beginFrame(LibGFX::VkContext& context);
+	uint64_t endFrame();
+	void wait(LibGFX::VkContext& context, uint64_t value) const;
+	uint64_t getCompletedValue(LibGFX::VkContext& context) const;
+	uint64_t getFrameValue() const { return m_submittedValue + 1; }
+	uint64_t getSubmittedValue() const { return m_submittedValue; }
+	uint32_t getCurrentFrame() const { return m_currentFrame; }
+	uint32_t getFramesInFlight() const { return static_cast<uint32_t>(m_slotValues.size()); }
+	VkSemaphore getSemaphore() const { return m_timeline; }
+	VkSemaphore getImageAvailableSemaphore() const { return m_imageAvailableSemaphores[m_currentFrame]; }
+	VkSemaphore getRenderFinishedSemaphore(uint32_t imageIndex) const { return m_renderFinishedSemaphores[imageIndex]; }
+};
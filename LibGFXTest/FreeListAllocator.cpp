@@ -0,0 +1,75 @@
+#include "FreeListAllocator.h"
+#include <iterator>
+#include <stdexcept>
+
+void FreeListAllocator::reset(uint32_t capacity)
+{
+	m_freeBlocks.clear();
+	m_capacity = capacity;
+	m_used = 0;
+	if (capacity > 0) {
+		m_freeBlocks[0] = capacity;
+	}
+}
+
+bool FreeListAllocator::allocate(uint32_t count, uint32_t& offset)
+{
+	// Empty ranges take nothing, freeing them again is a no-op
+	if (count == 0) {
+		offset = 0;
+		return true;
+	}
+
+	for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it) {
+		if (it->second < count) {
+			continue;
+		}
+
+		// Take the front of the block and keep the remainder in the list
+		offset = it->first;
+		uint32_t remaining = it->second - count;
+		m_freeBlocks.erase(it);
+		if (remaining > 0) {
+			m_freeBlocks[offset + count] = remaining;
+		}
+		m_used += count;
+		return true;
+	}
+	return false;
+}
+
+void FreeListAllocator::free(uint32_t offset, uint32_t count)
+{
+	if (count == 0) {
+		return;
+	}
+	if (offset > m_capacity || count > m_capacity - offset || count > m_used) {
+		throw std::runtime_error("invalid free-list range!");
+	}
+
+	// A range that overlaps a free block was already freed, or never allocated
+	auto next = m_freeBlocks.lower_bound(offset);
+	if ((next != m_freeBlocks.end() && next->first < offset + count) ||
+		(next != m_freeBlocks.begin() && std::prev(next)->first + std::prev(next)->second > offset)) {
+		throw std::runtime_error("free-list range is already free!");
+	}
+	m_used -= count;
+
+	// Merge with the previous block if it ends where this range starts
+	if (next != m_freeBlocks.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			count += prev->second;
+			m_freeBlocks.erase(prev);
+		}
+	}
+
+	// Merge with the following block if this range ends where it starts
+	if (next != m_freeBlocks.end() && offset + count == next->first) {
+		count += next->second;
+		m_freeBlocks.erase(next);
+	}
+
+	m_freeBlocks[offset] = count;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+// First-fit free-list allocator over an abstract range of elements.
+// Adjacent free blocks are merged again when ranges are released.
+class FreeListAllocator
+{
+private:
+	std::map<uint32_t, uint32_t> m_freeBlocks; // offset -> count
+	uint32_t m_capacity = 0;
+	uint32_t m_used = 0;
+
+public:
+	void reset(uint32_t capacity);
+	// A count of 0 always succeeds and takes no space
+	bool allocate(uint32_t count, uint32_t& offset);
+	// Throws on ranges outside the capacity or overlapping free space (double free)
+	void free(uint32_t offset, uint32_t count);
+	uint32_t getCapacity() const { return m_capacity; }
+	uint32_t getUsed() const { return m_used; }
+};
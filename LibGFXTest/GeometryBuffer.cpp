@@ -0,0 +1,100 @@
+#include "GeometryBuffer.h"
+#include <cstring>
+#include <stdexcept>
+
+void GeometryBuffer::create(LibGFX::VkContext& context, uint32_t maxVertices, uint32_t maxIndices)
+{
+	VkDevice device = context.getDevice();
+
+	m_vertexBuffer = context.createBuffer(
+		sizeof(Vertex3D) * maxVertices,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	m_indexBuffer = context.createBuffer(
+		sizeof(uint16_t) * maxIndices,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+
+	// Keep both buffers mapped for the lifetime of the arena
+	void* mapped = nullptr;
+	if (vkMapMemory(device, m_vertexBuffer.memory, 0, m_vertexBuffer.size, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map geometry vertex buffer!");
+	}
+	m_mappedVertices = static_cast<Vertex3D*>(mapped);
+
+	if (vkMapMemory(device, m_indexBuffer.memory, 0, m_indexBuffer.size, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map geometry index buffer!");
+	}
+	m_mappedIndices = static_cast<uint16_t*>(mapped);
+
+	m_vertexAllocator.reset(maxVertices);
+	m_indexAllocator.reset(maxIndices);
+}
+
+void GeometryBuffer::destroy(LibGFX::VkContext& context)
+{
+	VkDevice device = context.getDevice();
+	vkUnmapMemory(device, m_vertexBuffer.memory);
+	vkUnmapMemory(device, m_indexBuffer.memory);
+	m_mappedVertices = nullptr;
+	m_mappedIndices = nullptr;
+
+	context.destroyBuffer(m_vertexBuffer);
+	context.destroyBuffer(m_indexBuffer);
+}
+
+Mesh GeometryBuffer::allocateMesh(const std::vector<Vertex3D>& vertices, const std::vector<uint16_t>& indices)
+{
+	uint32_t vertexOffset = 0;
+	if (!m_vertexAllocator.allocate(static_cast<uint32_t>(vertices.size()), vertexOffset)) {
+		throw std::runtime_error("geometry buffer is out of vertex space!");
+	}
+
+	uint32_t firstIndex = 0;
+	if (!m_indexAllocator.allocate(static_cast<uint32_t>(indices.size()), firstIndex)) {
+		m_vertexAllocator.free(vertexOffset, static_cast<uint32_t>(vertices.size()));
+		throw std::runtime_error("geometry buffer is out of index space!");
+	}
+
+	// Indices stay relative to the mesh, vertexOffset rebases them at draw time
+	std::memcpy(m_mappedVertices + vertexOffset, vertices.data(), sizeof(Vertex3D) * vertices.size());
+	std::memcpy(m_mappedIndices + firstIndex, indices.data(), sizeof(uint16_t) * indices.size());
+
+	Mesh mesh;
+	mesh.vertexOffset = static_cast<int32_t>(vertexOffset);
+	mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+	mesh.firstIndex = firstIndex;
+	mesh.indexCount = static_cast<uint32_t>(indices.size());
+	return mesh;
+}
+
+void GeometryBuffer::freeMesh(Mesh& mesh, DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	// Draws recorded before lastValue may still read the ranges
+	Mesh freed = mesh;
+	deletionQueue.enqueue(lastValue, [this, freed](LibGFX::VkContext&) {
+		m_vertexAllocator.free(static_cast<uint32_t>(freed.vertexOffset), freed.vertexCount);
+		m_indexAllocator.free(freed.firstIndex, freed.indexCount);
+	});
+	mesh = Mesh();
+}
+
+void GeometryBuffer::bind(VkCommandBuffer commandBuffer) const
+{
+	VkBuffer vertexBuffers[] = { m_vertexBuffer.buffer };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0, getIndexType());
+}
+
+void GeometryBuffer::draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount) const
+{
+	// Meshes without indices draw their vertices in order
+	if (mesh.indexCount == 0) {
+		vkCmdDraw(commandBuffer, mesh.vertexCount, instanceCount, static_cast<uint32_t>(mesh.vertexOffset), 0);
+		return;
+	}
+	vkCmdDrawIndexed(commandBuffer, mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, 0);
+}
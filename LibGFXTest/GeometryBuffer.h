@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "VkContext.h"
+#include "Vertex.h"
+#include "FreeListAllocator.h"
+#include "DeletionQueue.h"
+
+// Range of a mesh inside the shared vertex and index buffers
+struct Mesh
+{
+	int32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+// One large vertex buffer and one large index buffer shared by all meshes.
+// Meshes are sub-allocated from free lists, so the buffers are bound once
+// per frame and draws only differ in vertexOffset / firstIndex.
+class GeometryBuffer
+{
+private:
+	LibGFX::Buffer m_vertexBuffer;
+	LibGFX::Buffer m_indexBuffer;
+	Vertex3D* m_mappedVertices = nullptr;
+	uint16_t* m_mappedIndices = nullptr;
+	FreeListAllocator m_vertexAllocator;
+	FreeListAllocator m_indexAllocator;
+
+public:
+	void create(LibGFX::VkContext& context, uint32_t maxVertices, uint32_t maxIndices);
+	void destroy(LibGFX::VkContext& context);
+	Mesh allocateMesh(const std::vector<Vertex3D>& vertices, const std::vector<uint16_t>& indices);
+	// The ranges return to the free lists once the frame timeline passed lastValue,
+	// the geometry buffer has to outlive the deletion queue entry
+	void freeMesh(Mesh& mesh, DeletionQueue& deletionQueue, uint64_t lastValue);
+	void bind(VkCommandBuffer commandBuffer) const;
+	void draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount = 1) const;
+	VkBuffer getVertexBuffer() const { return m_vertexBuffer.buffer; }
+	VkBuffer getIndexBuffer() const { return m_indexBuffer.buffer; }
+	VkIndexType getIndexType() const { return VK_INDEX_TYPE_UINT16; }
+};
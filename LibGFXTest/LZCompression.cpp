@@ -0,0 +1,155 @@
+#include "LZCompression.h"
+#include <cstring>
+
+static constexpr size_t kMinMatch = 4;
+static constexpr size_t kMaxOffset = 65535;
+static constexpr size_t kHashBits = 16;
+static constexpr size_t kLastLiterals = 5;
+
+static inline uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t hash4(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+static void writeLength(std::vector<uint8_t>& out, size_t length)
+{
+	while (length >= 255) {
+		out.push_back(255);
+		length -= 255;
+	}
+	out.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength >= kMinMatch ? matchLength - kMinMatch : 0;
+	uint8_t token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (matchLength >= kMinMatch) {
+		token |= static_cast<uint8_t>(matchCode >= 15 ? 15 : matchCode);
+	}
+	out.push_back(token);
+	if (literalLength >= 15) {
+		writeLength(out, literalLength - 15);
+	}
+	out.insert(out.end(), literals, literals + literalLength);
+
+	// The last sequence carries literals only
+	if (matchLength >= kMinMatch) {
+		out.push_back(static_cast<uint8_t>(offset & 0xFF));
+		out.push_back(static_cast<uint8_t>(offset >> 8));
+		if (matchCode >= 15) {
+			writeLength(out, matchCode - 15);
+		}
+	}
+}
+
+void lzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+{
+	out.clear();
+	out.reserve(size + size / 255 + 16);
+
+	std::vector<uint32_t> table(size_t(1) << kHashBits, UINT32_MAX);
+	size_t anchor = 0;
+	size_t position = 0;
+
+	// Greedy parse with a single candidate per hash bucket
+	while (size >= kMinMatch + kLastLiterals && position + kMinMatch + kLastLiterals <= size) {
+		uint32_t sequence = read32(src + position);
+		uint32_t& slot = table[hash4(sequence)];
+		size_t candidate = slot;
+		slot = static_cast<uint32_t>(position);
+
+		if (candidate == UINT32_MAX || position - candidate > kMaxOffset || read32(src + candidate) != sequence) {
+			position++;
+			continue;
+		}
+
+		size_t matchLength = kMinMatch;
+		size_t limit = size - kLastLiterals;
+		while (position + matchLength < limit && src[candidate + matchLength] == src[position + matchLength]) {
+			matchLength++;
+		}
+
+		writeSequence(out, src + anchor, position - anchor, position - candidate, matchLength);
+		position += matchLength;
+		anchor = position;
+	}
+
+	writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+bool lzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* in = src;
+	const uint8_t* inEnd = src + srcSize;
+	uint8_t* out = dst;
+	uint8_t* outEnd = dst + dstSize;
+
+	while (in < inEnd) {
+		uint8_t token = *in++;
+
+		// Literals
+		size_t literalLength = token >> 4;
+		if (literalLength == 15) {
+			uint8_t extra;
+			do {
+				if (in >= inEnd) return false;
+				extra = *in++;
+				literalLength += extra;
+			} while (extra == 255);
+		}
+		if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - out)) {
+			return false;
+		}
+		std::memcpy(out, in, literalLength);
+		in += literalLength;
+		out += literalLength;
+
+		// End of block after the final literal run
+		if (in == inEnd) {
+			break;
+		}
+
+		// Match
+		if (inEnd - in < 2) return false;
+		size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > static_cast<size_t>(out - dst)) {
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			uint8_t extra;
+			do {
+				if (in >= inEnd) return false;
+				extra = *in++;
+				matchLength += extra;
+			} while (extra == 255);
+		}
+		matchLength += kMinMatch;
+		if (matchLength > static_cast<size_t>(outEnd - out)) {
+			return false;
+		}
+
+		// Non-overlapping matches copy in one go, overlapping ones byte by byte
+		const uint8_t* match = out - offset;
+		if (offset >= matchLength) {
+			std::memcpy(out, match, matchLength);
+			out += matchLength;
+		}
+		else {
+			for (size_t i = 0; i < matchLength; i++) {
+				*out++ = match[i];
+			}
+		}
+	}
+	return out == outEnd;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Byte oriented LZ77 in the LZ4 block layout, used as texture supercompression.
+// Decoding needs no tables or allocations and writes straight into the destination.
+void lzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out);
+bool lzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
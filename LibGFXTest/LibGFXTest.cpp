@@ -13,8 +13,26 @@
 #include "DefaultPipeline.h"
 #include "DescriptorPoolBuilder.h"
 #include "Vertex.h"
-#include "DescriptorSetWriter.h"
+#include "DescriptorUpdateTemplate.h"
+#include "DescriptorBuffer.h"
+#include "DynamicRendering.h"
+#include "RenderGraph.h"
+#include "GeometryBuffer.h"
+#include "DrawList.h"
+#include "DeviceFeatures.h"
+#include "TransferQueue.h"
+#include "FrameSync.h"
+#include "DeletionQueue.h"
+#include "TextureFile.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "StreamingTexture.h"
+#include "SamplerCache.h"
+#include "TextureAtlas.h"
+#include <filesystem>
 #include <array>
+#include <algorithm>
+#include <chrono>
 #include "Imaging.h"
 #include "stb_image.h"
 
@@ -25,21 +43,7 @@ struct UniformBufferObject {
 	glm::mat4 proj;
 };
 
-LibGFX::ImageData createImageData(const std::string& imagePath) {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(imagePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (!pixels) {
-		throw std::runtime_error("Failed to load texture image!");
-	}
-	LibGFX::ImageData imageData;
-	imageData.pixels = pixels;
-	imageData.width = static_cast<uint32_t>(texWidth);
-	imageData.height = static_cast<uint32_t>(texHeight);
-	imageData.format = VK_FORMAT_R8G8B8A8_UNORM;
-	return imageData;
-}
-
-LibGFX::Buffer createVertexBuffer(LibGFX::VkContext* context) {
+Mesh createQuadMesh(GeometryBuffer& geometryBuffer) {
 
 	auto vertices = std::vector<Vertex3D>{
 		{{-0.5f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f}}, // Top Left
@@ -48,36 +52,50 @@ LibGFX::Buffer createVertexBuffer(LibGFX::VkContext* context) {
 		{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f}}, // Bottom Left
 	};
 
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-	LibGFX::Buffer vertexBuffer = context->createBuffer(
-		bufferSize,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	);
-
-	context->updateBuffer(vertexBuffer, vertices.data(), bufferSize);
-
-	return vertexBuffer;
-}
-
-LibGFX::Buffer createIndexBuffer(LibGFX::VkContext* context) {
 	auto indices = std::vector<uint16_t>{
 		0, 2, 3, // First Triangle
 		0, 1, 2  // Second Triangle
 	};
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-	LibGFX::Buffer indexBuffer = context->createBuffer(
-		bufferSize,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	);
-	context->updateBuffer(indexBuffer, indices.data(), bufferSize);
-	return indexBuffer;
+
+	return geometryBuffer.allocateMesh(vertices, indices);
+}
+
+// RGBA8 checkerboard of 4x4 texel cells in the given color and black
+std::vector<uint8_t> createCheckerPixels(uint32_t size, uint8_t red, uint8_t green, uint8_t blue) {
+	std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			bool lit = ((x / 4) + (y / 4)) % 2 == 0;
+			uint8_t* pixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+			pixel[0] = lit ? red : 0;
+			pixel[1] = lit ? green : 0;
+			pixel[2] = lit ? blue : 0;
+			pixel[3] = 255;
+		}
+	}
+	return pixels;
 }
 
-LibGFX::Buffer createUniformBuffer(LibGFX::VkContext* context) {
+Texture loadTexture(LibGFX::VkContext* context, TransferQueue& transferQueue, const std::string& imagePath) {
+	// Prefer a baked, block compressed version next to the source image (see TextureCompressor)
+	std::filesystem::path bakedPath(imagePath);
+	bakedPath.replace_extension(".gtex");
+	// The file is memory mapped and copied straight into the staging ring, no decode or heap copy
+	MappedTextureFile textureFile;
+	if (textureFile.open(bakedPath.string()) && isSampledFormatSupported(*context, getVkFormat(textureFile.getFormat()))) {
+		return transferQueue.uploadTexture(*context, textureFile);
+	}
+
+	// JPEG / PNG are decoded straight into the staging buffer
+	return transferQueue.uploadTexture(*context, imagePath);
+}
+
+LibGFX::Buffer createUniformBuffer(LibGFX::VkContext* context, bool addressable) {
 	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	// Descriptor buffers reference the uniform buffer by its device address
+	if (addressable) {
+		return DescriptorBuffer::createAddressableBuffer(*context, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	}
 	LibGFX::Buffer uniformBuffer = context->createBuffer(
 		bufferSize,
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -102,161 +120,414 @@ int main()
 	auto context = LibGFX::GFX::createContext(window);
 	context->initialize(LibGFX::VkContext::defaultAppInfo(), true);
 
+	// What the context created the device with. Vulkan cannot report enabled features, so these mirror
+	// VkContext::initialize, which enables timelineSemaphore. FrameSync and TransferQueue both require it,
+	// restrictToSupported only catches a device that lacks it. Keep this in step with LibGFX's device creation.
+	// The context creates no queue of a separate transfer family, so transferFamily stays VK_QUEUE_FAMILY_IGNORED:
+	// uploads are submitted on the graphics queue and the ownership transfer barriers are never recorded.
+	// Optional features stay off unless the context enables them, their paths fall back otherwise.
+	DeviceFeatures deviceFeatures;
+	deviceFeatures.timelineSemaphore = true;
+	deviceFeatures.synchronization2 = false;
+	deviceFeatures.dynamicRendering = false;
+	deviceFeatures.graphicsPipelineLibrary = false;
+	deviceFeatures.bufferDeviceAddress = false;
+	deviceFeatures.descriptorBuffer = false;
+	deviceFeatures.pushDescriptor = false;
+	deviceFeatures.restrictToSupported(*context);
+	if (!deviceFeatures.timelineSemaphore) {
+		cerr << "Timeline semaphores are not supported by the device!" << endl;
+		return -1;
+	}
+
 	// Create the swapchain with the desired present mode
 	auto swapchainInfo = context->createSwapChain(VK_PRESENT_MODE_MAILBOX_KHR);
 
-	// Create an optimal depth format and depth buffer
+	// Create an optimal depth format
 	VkFormat bestDepthFormat = context->findSuitableDepthFormat();
-	auto depthBuffer = context->createDepthBuffer(swapchainInfo.extent, bestDepthFormat);
 
-	// Create an render pass. Here we use the default render pass preset from LibGFX.
+	// With dynamic rendering the swapchain images and the depth image are attached directly, without render pass
+	// or framebuffer objects. Otherwise create a depth buffer and an render pass. Here we use the default render
+	// pass preset from LibGFX.
+	const bool useDynamicRendering = DynamicRendering::isSupported(*context, deviceFeatures);
+	DynamicRendering dynamicRendering;
+	LibGFX::DepthBuffer depthBuffer = {};
 	auto renderPass = std::make_unique<LibGFX::Presets::DefaultRenderPass>();
-	if (!renderPass->create(*context, swapchainInfo.surfaceFormat.format, depthBuffer.format)) {
-		cerr << "Failed to create default render pass!" << endl;
-		return -1;
+	if (useDynamicRendering) {
+		// The depth is transient and never stored, only the presented color image is written to memory. Renders
+		// with 4x MSAA (or what the device supports) resolved into the swapchain image.
+		AttachmentConfig attachmentConfig;
+		attachmentConfig.transientDepth = true;
+		attachmentConfig.depthStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentConfig.samples = VK_SAMPLE_COUNT_4_BIT;
+		dynamicRendering.setAttachmentConfig(attachmentConfig);
+		dynamicRendering.create(*context, swapchainInfo.swapchain, swapchainInfo.surfaceFormat.format, swapchainInfo.extent, bestDepthFormat);
+		std::cout << "Attachment stores per frame: " << dynamicRendering.getAttachmentTraffic() / 1024 << " KiB, "
+			<< dynamicRendering.getSampleCount() << "x MSAA, depth "
+			<< (dynamicRendering.isDepthLazilyAllocated() ? "lazily allocated" : "device local") << std::endl;
+	}
+	else {
+		depthBuffer = context->createDepthBuffer(swapchainInfo.extent, bestDepthFormat);
+		if (!renderPass->create(*context, swapchainInfo.surfaceFormat.format, depthBuffer.format)) {
+			cerr << "Failed to create default render pass!" << endl;
+			return -1;
+		}
 	}
 
+	// Barriers of the dynamic rendering pass, legacy pipeline barriers unless synchronization2 is enabled
+	RenderGraph renderGraph;
+	renderGraph.create(*context, deviceFeatures);
+
+	// Samplers are shared through the cache. The texture sampler never changes, it is baked into the texture layout.
+	SamplerCache samplerCache;
+	samplerCache.create(*context);
+	VkSampler textureSampler = samplerCache.acquire(*context, getMipmappedSamplerInfo(*context, true, 16.0f));
+
 	// Create the graphics pipeline. You need to create the pipeline for yourself.
 	auto pipeline = std::make_unique<DefaultPipeline>();
+	pipeline->setImmutableSampler(textureSampler);
+	pipeline->setPushDescriptors(deviceFeatures.pushDescriptor);
+	pipeline->setDescriptorBuffers(DescriptorBuffer::isSupported(*context, deviceFeatures));
+	pipeline->setPipelineLibraries(deviceFeatures.graphicsPipelineLibrary);
 	auto viewport = context->createViewport(0.0f, 0.0f, swapchainInfo.extent);
 	auto scissor = context->createScissorRect(0, 0, swapchainInfo.extent);
 	pipeline->setViewport(viewport);
 	pipeline->setScissor(scissor);
-	pipeline->setRenderPass(renderPass->getRenderPass());
+	if (useDynamicRendering) {
+		pipeline->setRenderingFormats(dynamicRendering.getColorFormat(), dynamicRendering.getDepthFormat());
+		pipeline->setSampleCount(dynamicRendering.getSampleCount());
+	}
+	else {
+		pipeline->setRenderPass(renderPass->getRenderPass());
+	}
 	pipeline->create(*context);
 
-	// Create framebuffer for each swapchain image
-	auto framebuffers = context->createFramebuffers(*renderPass, swapchainInfo, depthBuffer);
+	// Pipeline variants of the passes, all share the pipeline layout so bound descriptors stay valid between them.
+	// With the depth prepass the opaque geometry is first rendered depth only, the opaque pass then tests EQUAL
+	// against it and shades every covered pixel exactly once. Pays off in scenes with heavy overdraw.
+	// The variants are fetched every frame, fast linked ones are replaced once their optimized build finished.
+	const bool depthPrepass = false;
+
+	// Create framebuffer for each swapchain image, dynamic rendering needs none
+	std::vector<VkFramebuffer> framebuffers;
+	if (!useDynamicRendering) {
+		framebuffers = context->createFramebuffers(*renderPass, swapchainInfo, depthBuffer);
+	}
+	const uint32_t imageCount = useDynamicRendering ? dynamicRendering.getImageCount() : static_cast<uint32_t>(framebuffers.size());
 
 	// Create a command pool for command buffer allocation
 	auto queueFamilyIndices = context->getQueueFamilyIndices(context->getPhysicalDevice());
 	auto commandPool = context->createCommandPool(queueFamilyIndices.graphicsFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
 	// Allocate command buffers from the command pool
-	auto commandBuffers = context->allocateCommandBuffers(commandPool, static_cast<uint32_t>(framebuffers.size()));
+	auto commandBuffers = context->allocateCommandBuffers(commandPool, imageCount);
+
+	// Create the shared geometry buffers and upload the meshes into them
+	GeometryBuffer geometryBuffer;
+	geometryBuffer.create(*context, 65536, 196608);
+	auto quadMesh = createQuadMesh(geometryBuffer);
+	DrawList drawList;
 
 	// Create buffers for rendering
-	auto vertexBuffer = createVertexBuffer(context.get());				// Vertex buffer
-	auto indexBuffer = createIndexBuffer(context.get());				// Index buffer
 	std::vector<LibGFX::Buffer> uniformBuffers;							// Uniform buffers for each frame inflight
-	for (size_t i = 0; i < framebuffers.size(); i++) {
-		uniformBuffers.push_back(createUniformBuffer(context.get()));	// Create uniform buffer for the model-view-projection matrices
+	for (size_t i = 0; i < imageCount; i++) {
+		uniformBuffers.push_back(createUniformBuffer(context.get(), pipeline->usesDescriptorBuffers()));	// Create uniform buffer for the model-view-projection matrices
 	}
 
-	// Create descriptor pool for the uniform buffers
-	LibGFX::DescriptorPoolBuilder descriptorPoolBuilder;
-	descriptorPoolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(framebuffers.size()));
-	descriptorPoolBuilder.setMaxSets(static_cast<uint32_t>(framebuffers.size()));
-	auto descriptorPool = descriptorPoolBuilder.build(*context);
-	descriptorPoolBuilder.clear();
+	// With descriptor buffers every frame slot gets a uniforms and a texture set in one mapped buffer, the
+	// uniforms are written once and the sets are selected by offset when drawing
+	DescriptorBuffer descriptorBuffer;
+	std::vector<VkDeviceSize> uniformDescriptorOffsets;
+	std::vector<VkDeviceSize> textureDescriptorOffsets;
+	if (pipeline->usesDescriptorBuffers()) {
+		descriptorBuffer.create(*context, 65536);
+		for (size_t i = 0; i < imageCount; i++) {
+			uniformDescriptorOffsets.push_back(descriptorBuffer.allocate(*context, pipeline->getUniformsLayout()));
+			descriptorBuffer.writeBuffer(*context, uniformDescriptorOffsets[i], pipeline->getUniformsLayout(), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers[i]);
+			textureDescriptorOffsets.push_back(descriptorBuffer.allocate(*context, pipeline->getTextureLayout()));
+		}
+	}
 
-	// Create the uniform descriptor sets for the matrices for each framebuffer
-	LibGFX::DescriptorSetWriter descriptorSetWriter;
+	// Otherwise create the uniform descriptor sets for the matrices for each framebuffer. All sets are written
+	// in one batch through an update template reading one buffer info per set.
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> descriptorSets;
-	for (size_t i = 0; i < framebuffers.size(); i++) {
-		auto buffer = uniformBuffers[i];
-		auto descriptorSet = context->allocateDescriptorSet(descriptorPool, pipeline->getUniformsLayout());
-		descriptorSetWriter.addBufferInfo(buffer.buffer, 0, buffer.size)
-			.write(*context, descriptorSet, 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
-			.clear();
-
-		descriptorSets.push_back(descriptorSet);
+	DescriptorUpdateTemplate uniformsUpdateTemplate;
+	if (!pipeline->usesDescriptorBuffers()) {
+		LibGFX::DescriptorPoolBuilder descriptorPoolBuilder;
+		descriptorPoolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, imageCount);
+		descriptorPoolBuilder.setMaxSets(imageCount);
+		descriptorPool = descriptorPoolBuilder.build(*context);
+		descriptorPoolBuilder.clear();
+
+		uniformsUpdateTemplate.addEntry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0)
+			.create(*context, pipeline->getUniformsLayout());
+		std::vector<VkDescriptorBufferInfo> uniformBufferInfos;
+		for (size_t i = 0; i < imageCount; i++) {
+			auto buffer = uniformBuffers[i];
+			descriptorSets.push_back(context->allocateDescriptorSet(descriptorPool, pipeline->getUniformsLayout()));
+			uniformBufferInfos.push_back({ buffer.buffer, 0, buffer.size });
+		}
+		uniformsUpdateTemplate.update(*context, descriptorSets, uniformBufferInfos);
 	}
 
-	// Create texture image, image view and texture sampler
-	auto imageData = createImageData("C:/Users/andy1/Pictures/CF Logo 2.jpg");
-	auto textureSampler = context->createTextureSampler(true, 16.0f);
-	auto image = context->createImage(imageData, commandPool);
-	imageData.pixels = nullptr; // Image data has been copied to GPU, we can free the pixel data now
-
-	// Create descriptor pool for the texture sampler
-	LibGFX::DescriptorPoolBuilder textureDescriptorPoolBuilder;
-	textureDescriptorPoolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 250);
-	textureDescriptorPoolBuilder.setMaxSets(250);
-	auto textureDescriptorPool = textureDescriptorPoolBuilder.build(*context);
-
-	// Create descriptor set for the texture sampler. Layout is defined in the pipeline.
-	VkDescriptorSet textureDescriptorSet = context->allocateDescriptorSet(textureDescriptorPool, pipeline->getTextureLayout());
-	LibGFX::DescriptorSetWriter textureDescriptorSetWriter;
-	textureDescriptorSetWriter.addImageInfo(image.imageView, textureSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-		.write(*context, textureDescriptorSet, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
-		.clear();
-
-	// Create synchronization objects
-	int currentFrame = 0;
-	int maxFramesInFlight = static_cast<int>(framebuffers.size());
-	std::vector<VkFence> imagesInFlight(maxFramesInFlight, VK_NULL_HANDLE);
-	auto imageAvailableSemaphores = context->createSemaphores(static_cast<uint32_t>(framebuffers.size()));
-	auto renderFinishedSemaphores = context->createSemaphores(static_cast<uint32_t>(framebuffers.size()));
-	auto inFlightFences = context->createFences(static_cast<uint32_t>(framebuffers.size()), VK_FENCE_CREATE_SIGNALED_BIT);
+	// Create the transfer queue for texture uploads. Uses a transfer-only queue family when the device was created with one.
+	TransferQueue transferQueue;
+	transferQueue.create(*context, deviceFeatures);
+
+	// Worker threads for image decoding, large JPEGs are decoded in parallel
+	ThreadPool threadPool;
+	threadPool.create();
+	stbi_set_parallel_for(ThreadPool::parallelForCallback, &threadPool, static_cast<int>(threadPool.getThreadCount()));
+
+	// Textures are loaded through the cache, which evicts the least recently used ones when VRAM runs short
+	TextureCache textureCache;
+	textureCache.create(*context, [&](const std::string& path) {
+		return loadTexture(context.get(), transferQueue, path);
+	});
+
+	// A baked texture streams its mip levels by screen footprint, otherwise the image is loaded
+	// with its whole mip chain on first use
+	const std::string logoPath = "C:/Users/andy1/Pictures/CF Logo 2.jpg";
+	std::filesystem::path logoBakedPath(logoPath);
+	logoBakedPath.replace_extension(".gtex");
+	StreamingTexture streamingTexture;
+	streamingTexture.create(*context, transferQueue, logoBakedPath.string());
+	auto logoTexture = textureCache.add(logoPath);
+
+	// Small images share one atlas texture. They are placed on the atlas worker, the copies are recorded into
+	// the frame command buffer once the placement finished. The pixels have to live until then.
+	TextureAtlas textureAtlas;
+	textureAtlas.create(*context, 256, 256);
+	std::vector<std::vector<uint8_t>> iconPixels;
+	std::vector<LibGFX::ImageData> icons;
+	for (uint32_t i = 0; i < 8; i++) {
+		uint32_t size = 16u << (i % 3);
+		iconPixels.push_back(createCheckerPixels(size, (i & 1) ? 255 : 64, (i & 2) ? 255 : 64, (i & 4) ? 255 : 64));
+		LibGFX::ImageData icon;
+		icon.pixels = iconPixels.back().data();
+		icon.width = size;
+		icon.height = size;
+		icon.format = VK_FORMAT_R8G8B8A8_UNORM;
+		icons.push_back(icon);
+	}
+	auto iconHandles = textureAtlas.insert(std::move(icons));
+
+	// With push descriptors the texture is pushed per draw and descriptor buffers hold it in their slot range,
+	// neither needs a pool. Otherwise create a texture descriptor set per frame slot, layout is defined in the
+	// pipeline. A slot is written when the texture was (re)loaded since its last write, sets of frames in flight
+	// are never touched.
+	VkDescriptorPool textureDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> textureDescriptorSets;
+	std::vector<uint32_t> textureDescriptorVersions(imageCount, 0);
+	DescriptorUpdateTemplate textureUpdateTemplate;
+	if (!pipeline->usesPushDescriptors() && !pipeline->usesDescriptorBuffers()) {
+		LibGFX::DescriptorPoolBuilder textureDescriptorPoolBuilder;
+		textureDescriptorPoolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 250);
+		textureDescriptorPoolBuilder.setMaxSets(250);
+		textureDescriptorPool = textureDescriptorPoolBuilder.build(*context);
+
+		for (size_t i = 0; i < imageCount; i++) {
+			textureDescriptorSets.push_back(context->allocateDescriptorSet(textureDescriptorPool, pipeline->getTextureLayout()));
+		}
+		textureUpdateTemplate.addEntry(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0)
+			.create(*context, pipeline->getTextureLayout());
+	}
+
+	// Create synchronization objects. Command buffers, uniform buffers and descriptor sets are per frame slot,
+	// a slot is only reused once the graphics timeline passed the value of its last submit.
+	FrameSync frameSync;
+	frameSync.create(*context, imageCount, imageCount);
+
+	// Resources released while rendering are destroyed once the frame timeline passed their last use
+	DeletionQueue deletionQueue;
 
 	// Main loop
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 
-		// Wait for the fence to be signaled from the last frame
-		context->waitForFence(inFlightFences[currentFrame]);
+		// Wait until the frame slot is no longer used by the GPU
+		uint32_t currentFrame = frameSync.beginFrame(*context);
 
 		// Acquire next image from the swapchain
 		uint32_t imageIndex; 
-		context->acquireNextImage(swapchainInfo, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, imageIndex);
+		context->acquireNextImage(swapchainInfo, frameSync.getImageAvailableSemaphore(), VK_NULL_HANDLE, imageIndex);
+
+		// Update uniform buffer for this frame
+		updateUniformBuffer(context.get(), uniformBuffers[currentFrame]);
+
+		// Free staging memory of finished uploads and resources the GPU no longer uses
+		uint64_t completedValue = frameSync.getCompletedValue(*context);
+		transferQueue.collect(*context);
+		deletionQueue.collect(*context, completedValue);
+
+		// Stream the mip level matching the footprint of the quad (half the viewport), the previous image
+		// is released after the last submitted frame. Cached textures are marked as used by this frame
+		// and loaded again if the cache evicted them.
+		const Texture* texture = nullptr;
+		uint32_t textureVersion = 0;
+		if (streamingTexture.isCreated()) {
+			float footprint = 0.5f * static_cast<float>(std::max(swapchainInfo.extent.width, swapchainInfo.extent.height));
+			streamingTexture.request(streamingTexture.calculateLevel(footprint));
+			streamingTexture.update(*context, transferQueue, deletionQueue, frameSync.getSubmittedValue());
+			texture = &streamingTexture.getTexture();
+			textureVersion = streamingTexture.getVersion();
+		}
+		else {
+			texture = &textureCache.use(logoTexture, frameSync.getFrameValue());
+			textureVersion = textureCache.getVersion(logoTexture);
+		}
 
-		// Check if a previous frame is using this image (i.e. there is its fence to wait on)
-		if(imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			context->waitForFence(imagesInFlight[imageIndex]);
+		// Rewrite the texture descriptor set of this slot if the image changed since its last write
+		VkDescriptorSet textureDescriptorSet = textureDescriptorSets.empty() ? VK_NULL_HANDLE : textureDescriptorSets[currentFrame];
+		if (textureDescriptorVersions[currentFrame] != textureVersion) {
+			if (pipeline->usesDescriptorBuffers()) {
+				descriptorBuffer.writeImage(*context, textureDescriptorOffsets[currentFrame], pipeline->getTextureLayout(), 0,
+					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureSampler, texture->imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			else if (textureDescriptorSet != VK_NULL_HANDLE) {
+				VkDescriptorImageInfo textureInfo = { textureSampler, texture->imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+				textureUpdateTemplate.update(*context, textureDescriptorSet, textureInfo);
+			}
+			textureDescriptorVersions[currentFrame] = textureVersion;
 		}
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-		context->resetFence(inFlightFences[currentFrame]);
 
-		// Update uniform buffer for this frame
-		updateUniformBuffer(context.get(), uniformBuffers[imageIndex]);
+		// Evict textures not used by this frame while over the VRAM budget
+		textureCache.trim(*context, deletionQueue, frameSync.getFrameValue(), completedValue);
 
-		// Record command buffer, begin render pass and bind pipeline
-		context->beginCommandBuffer(commandBuffers[imageIndex]);
-		context->beginRenderPass(commandBuffers[imageIndex], *renderPass.get(), framebuffers[imageIndex], swapchainInfo.extent);
-		context->bindPipeline(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline.get());
+		// Swap in optimized pipeline variants, the fast linked ones may still be used by submitted frames
+		pipeline->updateVariants(deletionQueue, frameSync.getSubmittedValue());
+		VkPipeline prepassPipeline = depthPrepass ? pipeline->getVariant(*context, PipelineState::depthPrepass()) : VK_NULL_HANDLE;
+		VkPipeline opaquePipeline = pipeline->getVariant(*context, depthPrepass ? PipelineState::opaqueAfterPrepass() : PipelineState::opaque());
+		VkPipeline transparentPipeline = pipeline->getVariant(*context, PipelineState::transparent());
 
 		// Begin draw call
-		VkDescriptorSet descriptorSet = descriptorSets[imageIndex];
-		VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
-
-		// Bind descriptor sets to the pipeline
-		std::array<VkDescriptorSet, 2> descriptorSetsToBind = { descriptorSet, textureDescriptorSet };
-		vkCmdBindDescriptorSets(commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipeline->getPipelineLayout(),
-			0,
-			static_cast<uint32_t>(descriptorSetsToBind.size()),
-			descriptorSetsToBind.data(),
-			0,
-			nullptr
-		);
-
-		// Bind vertex and index buffers and issue draw call
-		VkBuffer vertexBuffers[] = { vertexBuffer.buffer };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, std::array<VkDeviceSize, 1>{0}.data());
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, 0);
-
-		// End render pass and command buffer recording
-		context->endRenderPass(commandBuffers[imageIndex]);
-		context->endCommandBuffer(commandBuffers[imageIndex]);
+		VkDescriptorSet descriptorSet = descriptorSets.empty() ? VK_NULL_HANDLE : descriptorSets[currentFrame];
+		VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+
+		// Record command buffer and acquire uploaded textures
+		context->beginCommandBuffer(commandBuffer);
+		uint64_t transferWaitValue = transferQueue.recordAcquireBarriers(commandBuffer);
+
+		// Copy newly placed atlas images, the staging memory is released with this frame
+		textureAtlas.recordUpdates(*context, commandBuffer, deletionQueue, frameSync.getFrameValue());
+		if (iconHandles.valid() && iconHandles.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			for (auto handle : iconHandles.get()) {
+				if (handle == TextureAtlas::InvalidHandle) {
+					continue;
+				}
+				auto region = textureAtlas.getRegion(handle);
+				std::cout << "Atlas image " << handle << ": " << region.width << "x" << region.height
+					<< " at " << region.x << ", " << region.y << std::endl;
+			}
+		}
+
+		// Draws of the forward pass, recorded inside the render pass or the dynamic rendering scope
+		auto recordForwardPass = [&](VkCommandBuffer commandBuffer) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepass ? prepassPipeline : opaquePipeline);
+
+			// Bind descriptor sets to the pipeline, a pushed texture is written inline after the uniforms set.
+			// Descriptor buffer sets are selected by their offsets in the bound buffer.
+			if (pipeline->usesDescriptorBuffers()) {
+				descriptorBuffer.bind(commandBuffer);
+				descriptorBuffer.setOffsets(commandBuffer, pipeline->getPipelineLayout(), 0,
+					{ uniformDescriptorOffsets[currentFrame], textureDescriptorOffsets[currentFrame] });
+			}
+			else {
+				std::array<VkDescriptorSet, 2> descriptorSetsToBind = { descriptorSet, textureDescriptorSet };
+				vkCmdBindDescriptorSets(commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					pipeline->getPipelineLayout(),
+					0,
+					pipeline->usesPushDescriptors() ? 1 : static_cast<uint32_t>(descriptorSetsToBind.size()),
+					descriptorSetsToBind.data(),
+					0,
+					nullptr
+				);
+			}
+			if (pipeline->usesPushDescriptors()) {
+				pipeline->pushTexture(commandBuffer, texture->imageView, textureSampler);
+			}
+
+			// Sort the draws of this frame, the quad is opaque
+			drawList.clear();
+			drawList.addOpaque(quadMesh, 0.0f);
+			drawList.sort();
+
+			// Bind the shared vertex and index buffers once, then draw each mesh by its range. Opaque first (after
+			// the optional depth prepass), blended transparent draws last, back to front.
+			geometryBuffer.bind(commandBuffer);
+			if (depthPrepass) {
+				drawList.drawOpaque(commandBuffer, geometryBuffer);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, opaquePipeline);
+			}
+			drawList.drawOpaque(commandBuffer, geometryBuffer);
+			if (drawList.hasTransparent()) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, transparentPipeline);
+				drawList.drawTransparent(commandBuffer, geometryBuffer);
+			}
+		};
+
+		// With dynamic rendering the forward pass runs in the render graph, which transitions the swapchain image,
+		// the depth and the multisampled color and hands the swapchain image to the presentation engine. The
+		// attachment contents of the last frame are discarded, the images start out undefined every frame.
+		if (useDynamicRendering) {
+			renderGraph.reset();
+			auto swapchainImage = renderGraph.importImage("swapchain", dynamicRendering.getColorImage(imageIndex), dynamicRendering.getColorView(imageIndex),
+				dynamicRendering.getColorFormat(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+			const Texture& depth = dynamicRendering.getDepth();
+			auto depthImage = renderGraph.importImage("depth", depth.image, depth.imageView, depth.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+			auto forwardPass = renderGraph.addPass("forward", [&](VkCommandBuffer commandBuffer) {
+				dynamicRendering.begin(commandBuffer, imageIndex);
+				recordForwardPass(commandBuffer);
+				dynamicRendering.end(commandBuffer);
+			});
+			forwardPass.write(swapchainImage, RenderGraph::Access::ColorAttachment).write(depthImage, RenderGraph::Access::DepthAttachment);
+			const Texture& multisampledColor = dynamicRendering.getMultisampledColor();
+			if (multisampledColor.image != VK_NULL_HANDLE) {
+				auto multisampledImage = renderGraph.importImage("multisampled color", multisampledColor.image, multisampledColor.imageView,
+					multisampledColor.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+				forwardPass.write(multisampledImage, RenderGraph::Access::ColorAttachment);
+			}
+			renderGraph.compile(*context, deletionQueue, frameSync.getSubmittedValue());
+			renderGraph.execute(commandBuffer);
+		}
+		else {
+			context->beginRenderPass(commandBuffer, *renderPass.get(), framebuffers[imageIndex], swapchainInfo.extent);
+			recordForwardPass(commandBuffer);
+			context->endRenderPass(commandBuffer);
+		}
+		context->endCommandBuffer(commandBuffer);
 
 		// Submit command buffer
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
+		VkSemaphore waitSemaphores[] = { frameSync.getImageAvailableSemaphore(), transferQueue.getSemaphore() };
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+		uint64_t waitValues[] = { 0, transferWaitValue }; // Binary semaphores ignore their value
+		submitInfo.waitSemaphoreCount = transferWaitValue > 0 ? 2 : 1;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		// Signal the present semaphore and the next value on the frame timeline
+		VkSemaphore signalSemaphores[] = { frameSync.getRenderFinishedSemaphore(imageIndex), frameSync.getSemaphore() };
+		uint64_t signalValues[] = { 0, frameSync.getFrameValue() };
+		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		context->submitCommandBuffer(submitInfo, inFlightFences[currentFrame]);
+		// Wait for the uploads whose ownership was acquired in this command buffer
+		VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+		timelineInfo.pWaitSemaphoreValues = waitValues;
+		timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+		submitInfo.pNext = &timelineInfo;
+
+		context->submitCommandBuffer(submitInfo, VK_NULL_HANDLE);
+		frameSync.endFrame();
 
 		// Present swapchain image
 		VkPresentInfoKHR presentInfo = {};
@@ -270,33 +541,38 @@ int main()
 		presentInfo.pImageIndices = &imageIndex;
 
 		context->queuePresent(presentInfo);
+	}
 
-		// Advance to the next frame
-		currentFrame = (currentFrame + 1) % maxFramesInFlight;
+	// Release the texture and frame resources, they are destroyed after the last submitted frame
+	uint64_t lastFrameValue = frameSync.getSubmittedValue();
+	streamingTexture.destroy(deletionQueue, lastFrameValue);
+	textureCache.destroy(deletionQueue, lastFrameValue);
+	if (textureDescriptorPool != VK_NULL_HANDLE) {
+		deletionQueue.destroyDescriptorSetPool(lastFrameValue, textureDescriptorPool);
+	}
+	for (auto uniformBuffer : uniformBuffers) {
+		deletionQueue.destroyBuffer(lastFrameValue, uniformBuffer);
 	}
+	if (descriptorPool != VK_NULL_HANDLE) {
+		deletionQueue.destroyDescriptorSetPool(lastFrameValue, descriptorPool);
+	}
+	descriptorBuffer.destroy(deletionQueue, lastFrameValue);
+	renderGraph.destroy(deletionQueue, lastFrameValue);
+	textureAtlas.destroy(deletionQueue, lastFrameValue);
+	geometryBuffer.freeMesh(quadMesh, deletionQueue, lastFrameValue);
 
-	// Wait for device to be idle before cleanup
+	// Wait for device to be idle before cleanup of the remaining objects
 	context->waitIdle();
+	deletionQueue.flush(*context);
 
 	// Destroy synchronization objects
-	context->destroySemaphores(imageAvailableSemaphores);
-	context->destroySemaphores(renderFinishedSemaphores);
-	context->destroyFences(inFlightFences);
-
-	// Destroy texture image
-	context->destroySampler(textureSampler);
-	context->destroyImage(image);
-	context->destroyDescriptorSetPool(textureDescriptorPool);
+	frameSync.destroy(*context);
+	transferQueue.destroy(*context);
+	stbi_set_parallel_for(nullptr, nullptr, 1);
+	threadPool.destroy();
 
 	// Destroy buffers
-	context->destroyBuffer(vertexBuffer);
-	context->destroyBuffer(indexBuffer);
-	for (auto uniformBuffer : uniformBuffers) {
-		context->destroyBuffer(uniformBuffer);
-	}
-
-	// Destroy descriptor pool
-	context->destroyDescriptorSetPool(descriptorPool);
+	geometryBuffer.destroy(*context);
 
 	// Destroy command buffers
 	for (auto commandBuffer : commandBuffers) {
@@ -309,12 +585,23 @@ int main()
 		context->destroyFramebuffer(framebuffer);
 	}
 
-	// Destroy pipeline and render pass
+	// Destroy the update templates, pipeline and render pass, then the samplers baked into the pipeline layouts
+	textureUpdateTemplate.destroy(*context);
+	uniformsUpdateTemplate.destroy(*context);
 	pipeline->destroy(*context);
-	renderPass->destroy(*context);
+	if (!useDynamicRendering) {
+		renderPass->destroy(*context);
+	}
+	samplerCache.destroy(*context);
 
-	// Destroy depth buffer and swapchain
-	context->destroyDepthBuffer(depthBuffer);
+	// Destroy the attachments and swapchain. A lazily allocated depth image reports what the device actually committed.
+	if (useDynamicRendering) {
+		std::cout << "Depth attachment memory: " << dynamicRendering.getDepthCommitment(*context) / 1024 << " KiB" << std::endl;
+		dynamicRendering.destroy(*context);
+	}
+	else {
+		context->destroyDepthBuffer(depthBuffer);
+	}
 	context->destroySwapChain(swapchainInfo);
 
 	// Dispose the Vulkan context
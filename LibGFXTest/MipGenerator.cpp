@@ -0,0 +1,112 @@
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPGEN_SSE2
+#include <emmintrin.h>
+#endif
+
+uint32_t calculateMipLevels(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+std::vector<MipLevel> calculateMipChain(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t mipLevels)
+{
+	std::vector<MipLevel> levels(mipLevels);
+	size_t offset = 0;
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		levels[i].width = width;
+		levels[i].height = height;
+		levels[i].offset = offset;
+		levels[i].size = static_cast<size_t>(width) * height * bytesPerPixel;
+
+		// Keep every level 16 byte aligned, satisfies bufferOffset alignment for copies
+		offset += (levels[i].size + 15) & ~static_cast<size_t>(15);
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+	return levels;
+}
+
+static inline void boxFilterPixel(const uint8_t* row0, const uint8_t* row1, uint32_t x0, uint32_t x1, uint8_t* dst)
+{
+	for (int c = 0; c < 4; c++) {
+		uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+		dst[c] = static_cast<uint8_t>((sum + 2) >> 2);
+	}
+}
+
+void downsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst)
+{
+	uint32_t dstWidth = std::max(1u, srcWidth / 2);
+	uint32_t dstHeight = std::max(1u, srcHeight / 2);
+	size_t srcPitch = static_cast<size_t>(srcWidth) * 4;
+
+	for (uint32_t y = 0; y < dstHeight; y++) {
+		const uint8_t* row0 = src + std::min(y * 2, srcHeight - 1) * srcPitch;
+		const uint8_t* row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcPitch;
+		uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+		uint32_t x = 0;
+
+#ifdef MIPGEN_SSE2
+		// Two output pixels per iteration from 4x2 source pixels
+		if (srcWidth >= 2) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rounding = _mm_set1_epi16(2);
+			for (; x + 2 <= dstWidth && (x * 2 + 4) <= srcWidth; x += 2) {
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+				hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+				__m128i sum = _mm_unpacklo_epi64(lo, hi);
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, zero));
+			}
+		}
+#endif
+
+		for (; x < dstWidth; x++) {
+			uint32_t x0 = std::min(x * 2, srcWidth - 1);
+			uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+			boxFilterPixel(row0, row1, x0, x1, out + x * 4);
+		}
+	}
+}
+
+void generateMipChainRGBA8(const uint8_t* pixels, const std::vector<MipLevel>& levels, uint8_t* dst)
+{
+	if (levels.empty()) {
+		return;
+	}
+
+	// Filter from cached scratch memory, dst may be uncached staging memory. Level 0 decoded straight
+	// into dst is read back once with a linear copy instead of by the filter.
+	std::vector<uint8_t> previous;
+	std::vector<uint8_t> current;
+	const uint8_t* source = pixels;
+	if (pixels != dst + levels[0].offset) {
+		std::memcpy(dst + levels[0].offset, pixels, levels[0].size);
+	}
+	else if (levels.size() > 1) {
+		previous.assign(pixels, pixels + levels[0].size);
+		source = previous.data();
+	}
+
+	for (size_t i = 1; i < levels.size(); i++) {
+		current.resize(levels[i].size);
+		downsampleRGBA8(source, levels[i - 1].width, levels[i - 1].height, current.data());
+		std::memcpy(dst + levels[i].offset, current.data(), levels[i].size);
+		previous.swap(current);
+		source = previous.data();
+	}
+}
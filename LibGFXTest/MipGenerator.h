@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Layout of one level inside a packed mip chain
+struct MipLevel
+{
+	uint32_t width;
+	uint32_t height;
+	size_t offset;
+	size_t size;
+};
+
+uint32_t calculateMipLevels(uint32_t width, uint32_t height);
+std::vector<MipLevel> calculateMipChain(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t mipLevels);
+
+// 2x2 box filter for RGBA8 images, odd edges repeat the last row / column
+void downsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+
+// Writes all levels of an RGBA8 mip chain into dst, level 0 is copied from pixels
+// unless pixels already points at level 0 inside dst
+void generateMipChainRGBA8(const uint8_t* pixels, const std::vector<MipLevel>& levels, uint8_t* dst);
@@ -0,0 +1,585 @@
+#include "RenderGraph.h"
+#include "Texture.h"
+#include <stdexcept>
+#include <algorithm>
+
+// Access bits that make memory writes available, reads only need execution dependencies
+static constexpr VkAccessFlags2 WriteAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+// The stages the graph uses have the same bits in the legacy flags, the split shader
+// read and write bits above 32 bits fold into SHADER_READ and SHADER_WRITE
+static VkAccessFlags toLegacyAccess(VkAccessFlags2 access)
+{
+	VkAccessFlags legacy = static_cast<VkAccessFlags>(access & 0xFFFFFFFFull);
+	if ((access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) != 0) {
+		legacy |= VK_ACCESS_SHADER_READ_BIT;
+	}
+	if ((access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) != 0) {
+		legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+	}
+	return legacy;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(ResourceHandle resource, Access access)
+{
+	m_graph.addAccess(m_pass, resource, access, false);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(ResourceHandle resource, Access access)
+{
+	m_graph.addAccess(m_pass, resource, access, true);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffect()
+{
+	m_graph.m_passes[m_pass].sideEffect = true;
+	return *this;
+}
+
+void RenderGraph::create(LibGFX::VkContext& context, const DeviceFeatures& features)
+{
+	// Core in Vulkan 1.3, VK_KHR_synchronization2 before. The entry point resolves on 1.3 devices
+	// without the feature, only the enabled feature allows calling it.
+	m_cmdPipelineBarrier2 = nullptr;
+	if (!features.synchronization2) {
+		return;
+	}
+	VkDevice device = context.getDevice();
+	m_cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2"));
+	if (m_cmdPipelineBarrier2 == nullptr) {
+		m_cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"));
+	}
+}
+
+void RenderGraph::destroy(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	releaseTransients(deletionQueue, lastValue);
+	reset();
+	m_signature.clear();
+	m_compiled = false;
+	m_order.clear();
+	m_passBarriers.clear();
+	m_finalBarriers.clear();
+	m_stats = Stats();
+}
+
+void RenderGraph::reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, VkImage image, VkImageView imageView, VkFormat format,
+	VkImageLayout initialLayout, VkImageLayout finalLayout)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc.format = format;
+	resource.imported = true;
+	resource.image = image;
+	resource.imageView = imageView;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+	if (desc.width == 0 || desc.height == 0 || desc.format == VK_FORMAT_UNDEFINED) {
+		throw std::runtime_error("render graph image needs an extent and a format!");
+	}
+
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	m_passes.push_back(std::move(pass));
+	return PassBuilder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+}
+
+void RenderGraph::addAccess(uint32_t pass, ResourceHandle resource, Access access, bool write)
+{
+	if (resource >= m_resources.size()) {
+		throw std::runtime_error("render graph resource does not exist!");
+	}
+
+	PassAccess passAccess = {};
+	passAccess.resource = resource;
+	passAccess.read = !write;
+	passAccess.write = write;
+	switch (access) {
+	case Access::ColorAttachment:
+		passAccess.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+		passAccess.access = write ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case Access::DepthAttachment:
+		// The depth test reads what it writes
+		passAccess.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+		passAccess.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+		passAccess.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		break;
+	case Access::DepthRead:
+		passAccess.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		passAccess.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case Access::FragmentSampled:
+	case Access::ComputeSampled:
+		passAccess.stages = access == Access::FragmentSampled ? VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		passAccess.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case Access::ComputeStorage:
+		passAccess.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		passAccess.access = write ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_GENERAL;
+		passAccess.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case Access::TransferSrc:
+		passAccess.stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		passAccess.access = VK_ACCESS_2_TRANSFER_READ_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		break;
+	case Access::TransferDst:
+		passAccess.stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		passAccess.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		passAccess.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		passAccess.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		break;
+	}
+
+	bool readOnly = access == Access::DepthRead || access == Access::FragmentSampled || access == Access::ComputeSampled || access == Access::TransferSrc;
+	if ((write && readOnly) || (!write && access == Access::TransferDst)) {
+		throw std::runtime_error("render graph access does not match read or write!");
+	}
+
+	// One image is used in one layout per pass, a read and a write of it are merged
+	auto& accesses = m_passes[pass].accesses;
+	auto it = std::find_if(accesses.begin(), accesses.end(), [&](const PassAccess& existing) { return existing.resource == resource; });
+	if (it == accesses.end()) {
+		accesses.push_back(passAccess);
+		return;
+	}
+	if (it->layout != passAccess.layout) {
+		throw std::runtime_error("render graph pass uses an image in two layouts!");
+	}
+	it->stages |= passAccess.stages;
+	it->access |= passAccess.access;
+	it->usage |= passAccess.usage;
+	it->read |= passAccess.read;
+	it->write |= passAccess.write;
+}
+
+std::vector<uint64_t> RenderGraph::buildSignature() const
+{
+	// Everything the compiled graph depends on, the imported images themselves may change every frame
+	std::vector<uint64_t> signature;
+	signature.push_back(m_resources.size());
+	for (const auto& resource : m_resources) {
+		signature.insert(signature.end(), {
+			resource.imported ? 1u : 0u, resource.desc.width, resource.desc.height,
+			static_cast<uint64_t>(resource.desc.format), resource.desc.usage,
+			static_cast<uint64_t>(resource.initialLayout), static_cast<uint64_t>(resource.finalLayout) });
+	}
+
+	signature.push_back(m_passes.size());
+	for (const auto& pass : m_passes) {
+		signature.insert(signature.end(), { std::hash<std::string>()(pass.name), pass.sideEffect ? 1u : 0u, pass.accesses.size() });
+		for (const auto& access : pass.accesses) {
+			signature.insert(signature.end(), {
+				access.resource, access.stages, access.access, static_cast<uint64_t>(access.layout),
+				(access.read ? 1u : 0u) | (access.write ? 2u : 0u) });
+		}
+	}
+	return signature;
+}
+
+void RenderGraph::cull()
+{
+	// Walk back from the imported images, a pass lives if it writes something a later pass or the
+	// outside of the graph still needs. A pure write ends the need for earlier writers.
+	std::vector<bool> needed(m_resources.size(), false);
+	for (size_t i = 0; i < m_resources.size(); i++) {
+		needed[i] = m_resources[i].imported;
+	}
+
+	std::vector<bool> alive(m_passes.size(), false);
+	for (size_t i = m_passes.size(); i-- > 0;) {
+		const Pass& pass = m_passes[i];
+		bool isAlive = pass.sideEffect;
+		for (const auto& access : pass.accesses) {
+			isAlive |= access.write && needed[access.resource];
+		}
+		if (!isAlive) {
+			m_stats.culledPasses++;
+			continue;
+		}
+
+		alive[i] = true;
+		for (const auto& access : pass.accesses) {
+			if (access.write && !access.read) {
+				needed[access.resource] = false;
+			}
+		}
+		for (const auto& access : pass.accesses) {
+			if (access.read) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	m_order.clear();
+	for (uint32_t i = 0; i < m_passes.size(); i++) {
+		if (alive[i]) {
+			m_order.push_back(i);
+		}
+	}
+}
+
+void RenderGraph::allocateTransients(LibGFX::VkContext& context)
+{
+	VkDevice device = context.getDevice();
+
+	// Lifetime of each transient image as first and last position in the compiled order
+	std::vector<uint32_t> firstUse(m_resources.size(), UINT32_MAX);
+	std::vector<uint32_t> lastUse(m_resources.size(), 0);
+	std::vector<VkImageUsageFlags> usage(m_resources.size(), 0);
+	for (uint32_t i = 0; i < m_order.size(); i++) {
+		for (const auto& access : m_passes[m_order[i]].accesses) {
+			firstUse[access.resource] = std::min(firstUse[access.resource], i);
+			lastUse[access.resource] = std::max(lastUse[access.resource], i);
+			usage[access.resource] |= access.usage;
+		}
+	}
+
+	// Images of culled passes are not created at all
+	struct Candidate
+	{
+		ResourceHandle resource;
+		VkMemoryRequirements requirements;
+	};
+	std::vector<Candidate> candidates;
+	m_transients.assign(m_resources.size(), TransientImage());
+	for (ResourceHandle i = 0; i < m_resources.size(); i++) {
+		const Resource& resource = m_resources[i];
+		if (resource.imported || firstUse[i] == UINT32_MAX) {
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { resource.desc.width, resource.desc.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.desc.usage | usage[i];
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateImage(device, &imageInfo, nullptr, &m_transients[i].image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render graph image!");
+		}
+
+		Candidate candidate;
+		candidate.resource = i;
+		vkGetImageMemoryRequirements(device, m_transients[i].image, &candidate.requirements);
+		candidates.push_back(candidate);
+		m_stats.unaliasedMemory += candidate.requirements.size;
+	}
+
+	// Largest images first, each goes into the first block it shares no lifetime with
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.requirements.size > b.requirements.size;
+	});
+	for (const auto& candidate : candidates) {
+		uint32_t first = firstUse[candidate.resource];
+		uint32_t last = lastUse[candidate.resource];
+		uint32_t blockIndex = 0;
+		for (; blockIndex < m_blocks.size(); blockIndex++) {
+			const MemoryBlock& block = m_blocks[blockIndex];
+			bool overlaps = std::any_of(block.lifetimes.begin(), block.lifetimes.end(), [&](const std::pair<uint32_t, uint32_t>& lifetime) {
+				return first <= lifetime.second && lifetime.first <= last;
+			});
+			if (!overlaps && (block.memoryTypeBits & candidate.requirements.memoryTypeBits) != 0) {
+				break;
+			}
+		}
+		if (blockIndex == m_blocks.size()) {
+			m_blocks.push_back(MemoryBlock());
+		}
+
+		// Every image of a block is bound at offset 0, the block is as large as its largest image
+		MemoryBlock& block = m_blocks[blockIndex];
+		block.size = std::max(block.size, candidate.requirements.size);
+		block.memoryTypeBits &= candidate.requirements.memoryTypeBits;
+		block.lifetimes.push_back({ first, last });
+		m_transients[candidate.resource].block = blockIndex;
+	}
+
+	for (auto& block : m_blocks) {
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = findMemoryType(context, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate render graph memory!");
+		}
+		m_stats.transientMemory += block.size;
+	}
+
+	for (const auto& candidate : candidates) {
+		TransientImage& transient = m_transients[candidate.resource];
+		vkBindImageMemory(device, transient.image, m_blocks[transient.block].memory, 0);
+
+		const Resource& resource = m_resources[candidate.resource];
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = transient.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = resource.desc.format;
+		viewInfo.subresourceRange = { getAspectMask(resource.desc.format), 0, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &transient.imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render graph image view!");
+		}
+		m_stats.transientImages++;
+	}
+}
+
+void RenderGraph::buildBarriers()
+{
+	// Imported images may have been used by anything before the graph, e.g. the acquire semaphore wait
+	std::vector<State> states(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); i++) {
+		if (m_resources[i].imported) {
+			states[i].layout = m_resources[i].initialLayout;
+			states[i].writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			states[i].writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+		}
+	}
+
+	std::vector<ResourceHandle> blockOccupants(m_blocks.size(), InvalidResource);
+	std::vector<bool> started(m_resources.size(), false);
+	m_passBarriers.assign(m_order.size(), std::vector<Barrier>());
+	for (size_t i = 0; i < m_order.size(); i++) {
+		for (const auto& access : m_passes[m_order[i]].accesses) {
+			State& state = states[access.resource];
+
+			// A transient image taking over aliased memory waits for the last use of the previous occupant
+			if (!m_resources[access.resource].imported && !started[access.resource]) {
+				started[access.resource] = true;
+				ResourceHandle& occupant = blockOccupants[m_transients[access.resource].block];
+				if (occupant != InvalidResource) {
+					state.writeStages = states[occupant].writeStages | states[occupant].readStages;
+					state.writeAccess = states[occupant].writeAccess;
+				}
+				occupant = access.resource;
+			}
+
+			// Layout transitions and writes wait for all earlier accesses, reads only for the last write
+			// and only once per stage
+			bool layoutChange = state.layout != access.layout;
+			bool hazard = access.write ? (state.writeStages | state.readStages) != 0
+				: state.writeStages != 0 && (access.stages & ~state.visibleStages) != 0;
+			if (layoutChange || hazard) {
+				Barrier barrier;
+				barrier.resource = access.resource;
+				barrier.srcStages = (layoutChange || access.write) ? state.writeStages | state.readStages : state.writeStages;
+				barrier.srcAccess = state.writeAccess;
+				barrier.dstStages = access.stages;
+				barrier.dstAccess = access.access;
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = access.layout;
+				m_passBarriers[i].push_back(barrier);
+				m_stats.barriers++;
+			}
+
+			if (access.write) {
+				state.writeStages = access.stages;
+				state.writeAccess = access.access & WriteAccessMask;
+				state.readStages = 0;
+				state.visibleStages = 0;
+			}
+			else if (layoutChange) {
+				// The transition is the last write, later readers in other stages wait for it
+				state.writeStages = access.stages;
+				state.writeAccess = 0;
+				state.readStages = access.stages;
+				state.visibleStages = access.stages;
+			}
+			else {
+				state.readStages |= access.stages;
+				state.visibleStages |= hazard ? access.stages : 0;
+			}
+			state.layout = access.layout;
+		}
+	}
+
+	// Imported images leave the graph in the layout the outside expects
+	m_finalBarriers.clear();
+	for (ResourceHandle i = 0; i < m_resources.size(); i++) {
+		const Resource& resource = m_resources[i];
+		if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || states[i].layout == resource.finalLayout) {
+			continue;
+		}
+
+		Barrier barrier;
+		barrier.resource = i;
+		barrier.srcStages = states[i].writeStages | states[i].readStages;
+		barrier.srcAccess = states[i].writeAccess;
+		barrier.dstStages = VK_PIPELINE_STAGE_2_NONE;
+		barrier.dstAccess = VK_ACCESS_2_NONE;
+		barrier.oldLayout = states[i].layout;
+		barrier.newLayout = resource.finalLayout;
+		m_finalBarriers.push_back(barrier);
+		m_stats.barriers++;
+	}
+}
+
+void RenderGraph::releaseTransients(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	// Images go first, then the memory they alias
+	for (const auto& transient : m_transients) {
+		if (transient.image == VK_NULL_HANDLE) {
+			continue;
+		}
+		VkImage image = transient.image;
+		VkImageView imageView = transient.imageView;
+		deletionQueue.enqueue(lastValue, [image, imageView](LibGFX::VkContext& context) {
+			vkDestroyImageView(context.getDevice(), imageView, nullptr);
+			vkDestroyImage(context.getDevice(), image, nullptr);
+		});
+	}
+	for (const auto& block : m_blocks) {
+		VkDeviceMemory memory = block.memory;
+		deletionQueue.enqueue(lastValue, [memory](LibGFX::VkContext& context) {
+			vkFreeMemory(context.getDevice(), memory, nullptr);
+		});
+	}
+	m_transients.clear();
+	m_blocks.clear();
+}
+
+void RenderGraph::compile(LibGFX::VkContext& context, DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	std::vector<uint64_t> signature = buildSignature();
+	if (m_compiled && signature == m_signature) {
+		return;
+	}
+
+	releaseTransients(deletionQueue, lastValue);
+	m_signature = std::move(signature);
+	m_stats = Stats();
+	m_stats.passes = static_cast<uint32_t>(m_passes.size());
+	cull();
+	allocateTransients(context);
+	buildBarriers();
+	m_compiled = true;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const
+{
+	if (barriers.empty()) {
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	imageBarriers.reserve(barriers.size());
+	for (const auto& barrier : barriers) {
+		VkImageMemoryBarrier2 imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		imageBarrier.srcStageMask = barrier.srcStages;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstStageMask = barrier.dstStages;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = getImage(barrier.resource);
+		imageBarrier.subresourceRange = { getAspectMask(m_resources[barrier.resource].desc.format), 0, 1, 0, 1 };
+		imageBarriers.push_back(imageBarrier);
+	}
+
+	// Legacy barriers share one pair of stage masks, an empty source waits for nothing and an empty
+	// destination blocks nothing
+	if (m_cmdPipelineBarrier2 == nullptr) {
+		std::vector<VkImageMemoryBarrier> legacyBarriers;
+		legacyBarriers.reserve(imageBarriers.size());
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		for (const auto& imageBarrier : imageBarriers) {
+			VkImageMemoryBarrier legacyBarrier = {};
+			legacyBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			legacyBarrier.srcAccessMask = toLegacyAccess(imageBarrier.srcAccessMask);
+			legacyBarrier.dstAccessMask = toLegacyAccess(imageBarrier.dstAccessMask);
+			legacyBarrier.oldLayout = imageBarrier.oldLayout;
+			legacyBarrier.newLayout = imageBarrier.newLayout;
+			legacyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			legacyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			legacyBarrier.image = imageBarrier.image;
+			legacyBarrier.subresourceRange = imageBarrier.subresourceRange;
+			legacyBarriers.push_back(legacyBarrier);
+			srcStages |= static_cast<VkPipelineStageFlags>(imageBarrier.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(imageBarrier.dstStageMask);
+		}
+		vkCmdPipelineBarrier(commandBuffer,
+			srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(legacyBarriers.size()), legacyBarriers.data());
+		return;
+	}
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+	dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+	m_cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) const
+{
+	if (!m_compiled) {
+		throw std::runtime_error("render graph was not compiled!");
+	}
+
+	for (size_t i = 0; i < m_order.size(); i++) {
+		recordBarriers(commandBuffer, m_passBarriers[i]);
+		const Pass& pass = m_passes[m_order[i]];
+		if (pass.execute) {
+			pass.execute(commandBuffer);
+		}
+	}
+	recordBarriers(commandBuffer, m_finalBarriers);
+}
+
+VkImage RenderGraph::getImage(ResourceHandle resource) const
+{
+	const Resource& declared = m_resources.at(resource);
+	return declared.imported ? declared.image : m_transients.at(resource).image;
+}
+
+VkImageView RenderGraph::getImageView(ResourceHandle resource) const
+{
+	const Resource& declared = m_resources.at(resource);
+	return declared.imported ? declared.imageView : m_transients.at(resource).imageView;
+}
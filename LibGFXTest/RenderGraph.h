@@ -0,0 +1,183 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include "VkContext.h"
+#include "DeletionQueue.h"
+#include "DeviceFeatures.h"
+
+// Frame graph for the passes of a frame. Passes declare which images they read and
+// write, the graph culls passes whose output nothing consumes, derives the layout
+// transitions and dependencies and records them in front of each pass as one
+// vkCmdPipelineBarrier2 batch, or one vkCmdPipelineBarrier without synchronization2.
+// Transient images are allocated by the graph, images whose lifetimes do not
+// overlap share memory. The graph is declared again every frame (reset, import /
+// create, addPass), a declaration equal to the last compiled one reuses the
+// compiled barriers and images.
+class RenderGraph
+{
+public:
+	using ResourceHandle = uint32_t;
+	static constexpr ResourceHandle InvalidResource = UINT32_MAX;
+
+	// How a pass uses an image, decides layout, stages and access masks
+	enum class Access
+	{
+		ColorAttachment,
+		DepthAttachment,
+		DepthRead,
+		FragmentSampled,
+		ComputeSampled,
+		ComputeStorage,
+		TransferSrc,
+		TransferDst
+	};
+
+	// Transient image, usage is completed from the accesses of the passes
+	struct ImageDesc
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkImageUsageFlags usage = 0;
+	};
+
+	struct Stats
+	{
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t barriers = 0;
+		uint32_t transientImages = 0;
+		VkDeviceSize transientMemory = 0;		// Memory allocated for the transient images
+		VkDeviceSize unaliasedMemory = 0;		// Memory they would need without aliasing
+	};
+
+	class PassBuilder
+	{
+	private:
+		RenderGraph& m_graph;
+		uint32_t m_pass;
+
+	public:
+		PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+		PassBuilder& read(ResourceHandle resource, Access access);
+		PassBuilder& write(ResourceHandle resource, Access access);
+		// Never culled, for passes with effects outside the graph
+		PassBuilder& sideEffect();
+	};
+
+private:
+	struct Resource
+	{
+		std::string name;
+		ImageDesc desc;
+		bool imported = false;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	struct PassAccess
+	{
+		ResourceHandle resource;
+		VkPipelineStageFlags2 stages;
+		VkAccessFlags2 access;
+		VkImageLayout layout;
+		VkImageUsageFlags usage;
+		bool read;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<PassAccess> accesses;
+		bool sideEffect = false;
+	};
+
+	struct Barrier
+	{
+		ResourceHandle resource;
+		VkPipelineStageFlags2 srcStages;
+		VkAccessFlags2 srcAccess;
+		VkPipelineStageFlags2 dstStages;
+		VkAccessFlags2 dstAccess;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+	};
+
+	// Synchronization state of an image while the barriers are derived
+	struct State
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 writeStages = 0;
+		VkAccessFlags2 writeAccess = 0;
+		VkPipelineStageFlags2 readStages = 0;
+		VkPipelineStageFlags2 visibleStages = 0;
+	};
+
+	// Memory shared by transient images with disjoint lifetimes
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeBits = ~0u;
+		std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+	};
+
+	struct TransientImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		uint32_t block = UINT32_MAX;
+	};
+
+	// Declaration of the current frame
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+
+	// Compiled graph, valid while the declaration matches m_signature
+	std::vector<uint64_t> m_signature;
+	bool m_compiled = false;
+	std::vector<uint32_t> m_order;
+	std::vector<std::vector<Barrier>> m_passBarriers;
+	std::vector<Barrier> m_finalBarriers;
+	std::vector<TransientImage> m_transients;
+	std::vector<MemoryBlock> m_blocks;
+	Stats m_stats;
+
+	PFN_vkCmdPipelineBarrier2 m_cmdPipelineBarrier2 = nullptr;
+
+	void addAccess(uint32_t pass, ResourceHandle resource, Access access, bool write);
+	std::vector<uint64_t> buildSignature() const;
+	void cull();
+	void allocateTransients(LibGFX::VkContext& context);
+	void buildBarriers();
+	void releaseTransients(DeletionQueue& deletionQueue, uint64_t lastValue);
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const;
+
+public:
+	// Uses vkCmdPipelineBarrier2 when synchronization2 is enabled on the device
+	void create(LibGFX::VkContext& context, const DeviceFeatures& features);
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastValue);
+
+	// Clears the declaration, the compiled graph is kept
+	void reset();
+	// Imported images may have been written by anything before the graph
+	ResourceHandle importImage(const std::string& name, VkImage image, VkImageView imageView, VkFormat format,
+		VkImageLayout initialLayout, VkImageLayout finalLayout);
+	ResourceHandle createImage(const std::string& name, const ImageDesc& desc);
+	PassBuilder addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute);
+
+	// Recompiles when the declaration changed, replaced transient images are released after lastValue
+	void compile(LibGFX::VkContext& context, DeletionQueue& deletionQueue, uint64_t lastValue);
+	void execute(VkCommandBuffer commandBuffer) const;
+
+	VkImage getImage(ResourceHandle resource) const;
+	VkImageView getImageView(ResourceHandle resource) const;
+	const Stats& getStats() const { return m_stats; }
+};
@@ -0,0 +1,84 @@
+#include "SamplerCache.h"
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+
+static_assert(sizeof(VkSamplerCreateInfo) - offsetof(VkSamplerCreateInfo, flags) == 16 * sizeof(uint32_t),
+	"sampler cache key does not cover VkSamplerCreateInfo");
+
+size_t SamplerCache::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the state words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : key) {
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+SamplerCache::Key SamplerCache::makeKey(const VkSamplerCreateInfo& samplerInfo)
+{
+	// Extension structs are not part of the key
+	if (samplerInfo.pNext != nullptr) {
+		throw std::runtime_error("sampler cache does not support extended sampler create info!");
+	}
+
+	Key key;
+	std::memcpy(key.data(), &samplerInfo.flags, sizeof(Key));
+	return key;
+}
+
+void SamplerCache::create(LibGFX::VkContext& context)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &properties);
+	m_maxSamplers = properties.limits.maxSamplerAllocationCount;
+}
+
+void SamplerCache::destroy(LibGFX::VkContext& context)
+{
+	// Remaining samplers may be immutable samplers of layouts, destroy after those
+	for (auto& sampler : m_samplers) {
+		context.destroySampler(sampler.second.sampler);
+	}
+	m_samplers.clear();
+	m_keys.clear();
+}
+
+VkSampler SamplerCache::acquire(LibGFX::VkContext& context, const VkSamplerCreateInfo& samplerInfo)
+{
+	Key key = makeKey(samplerInfo);
+	auto it = m_samplers.find(key);
+	if (it != m_samplers.end()) {
+		it->second.references++;
+		return it->second.sampler;
+	}
+
+	if (m_samplers.size() >= m_maxSamplers) {
+		throw std::runtime_error("sampler allocation limit reached!");
+	}
+
+	VkSampler sampler;
+	if (vkCreateSampler(context.getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+	m_samplers.emplace(key, Entry{ sampler, 1 });
+	m_keys.emplace(sampler, key);
+	return sampler;
+}
+
+void SamplerCache::release(VkSampler sampler, DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	auto keyIt = m_keys.find(sampler);
+	if (keyIt == m_keys.end()) {
+		throw std::runtime_error("sampler was not acquired from the cache!");
+	}
+
+	// The last user is gone, frames up to lastValue may still sample with it
+	auto it = m_samplers.find(keyIt->second);
+	if (--it->second.references == 0) {
+		deletionQueue.destroySampler(lastValue, sampler);
+		m_samplers.erase(it);
+		m_keys.erase(keyIt);
+	}
+}
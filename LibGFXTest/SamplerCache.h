@@ -0,0 +1,41 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+#include "VkContext.h"
+#include "DeletionQueue.h"
+
+// Shares samplers between textures. Samplers are looked up by their complete
+// create info state and reference counted, the last release hands the sampler
+// to the deletion queue. Keeps the sampler count far below maxSamplerAllocationCount.
+class SamplerCache
+{
+private:
+	// Every VkSamplerCreateInfo member after pNext, as raw 32 bit words
+	using Key = std::array<uint32_t, 16>;
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		VkSampler sampler;
+		uint32_t references;
+	};
+
+	std::unordered_map<Key, Entry, KeyHash> m_samplers;
+	std::unordered_map<VkSampler, Key> m_keys;
+	uint32_t m_maxSamplers = 0;
+
+	static Key makeKey(const VkSamplerCreateInfo& samplerInfo);
+
+public:
+	void create(LibGFX::VkContext& context);
+	void destroy(LibGFX::VkContext& context);
+	VkSampler acquire(LibGFX::VkContext& context, const VkSamplerCreateInfo& samplerInfo);
+	void release(VkSampler sampler, DeletionQueue& deletionQueue, uint64_t lastValue);
+	size_t size() const { return m_samplers.size(); }
+};
@@ -0,0 +1,65 @@
+#include "StreamingTexture.h"
+#include <algorithm>
+#include <cmath>
+
+bool StreamingTexture::create(LibGFX::VkContext& context, TransferQueue& transferQueue, const std::string& path, uint32_t tailSize)
+{
+	if (!m_file.open(path) || !isSampledFormatSupported(context, getVkFormat(m_file.getFormat()))) {
+		m_file.close();
+		return false;
+	}
+
+	// The mip tail (levels up to tailSize texels) is always resident, streaming starts from there
+	m_tailLevel = 0;
+	while (m_tailLevel + 1 < m_file.getLevelCount() &&
+		std::max(m_file.getWidth() >> m_tailLevel, m_file.getHeight() >> m_tailLevel) > tailSize) {
+		m_tailLevel++;
+	}
+	m_residentLevel = m_tailLevel;
+	m_wantedLevel = static_cast<float>(m_tailLevel);
+	m_texture = transferQueue.uploadTexture(context, m_file, m_residentLevel);
+	m_version++;
+	return true;
+}
+
+void StreamingTexture::destroy(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	if (isCreated()) {
+		deletionQueue.destroyTexture(lastValue, m_texture);
+		m_texture = Texture();
+	}
+	m_file.close();
+}
+
+float StreamingTexture::calculateLevel(float screenSize) const
+{
+	// CPU estimate from the screen space footprint: one texel per pixel is the wanted level
+	float textureSize = static_cast<float>(std::max(m_file.getWidth(), m_file.getHeight()));
+	float level = std::log2(textureSize / std::max(screenSize, 1.0f));
+	return std::clamp(level, 0.0f, static_cast<float>(m_file.getLevelCount() - 1));
+}
+
+bool StreamingTexture::update(LibGFX::VkContext& context, TransferQueue& transferQueue, DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	// Finer levels stream one at a time, coarser ones drop once a whole level is unused (avoids
+	// thrashing at a level boundary). The mip tail is never dropped.
+	uint32_t wanted = static_cast<uint32_t>(std::floor(m_wantedLevel));
+	uint32_t level = m_residentLevel;
+	if (wanted < m_residentLevel) {
+		level = m_residentLevel - 1;
+	}
+	else if (m_wantedLevel >= static_cast<float>(m_residentLevel + 1)) {
+		level = std::min(wanted, m_tailLevel);
+	}
+	if (level == m_residentLevel) {
+		return false;
+	}
+
+	// Frames up to lastValue may still sample the old image
+	Texture texture = transferQueue.uploadTexture(context, m_file, level);
+	deletionQueue.destroyTexture(lastValue, m_texture);
+	m_texture = texture;
+	m_residentLevel = level;
+	m_version++;
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+#include "VkContext.h"
+#include "Texture.h"
+#include "TextureFile.h"
+#include "TransferQueue.h"
+#include "DeletionQueue.h"
+
+// Texture streamed by mip level from a baked texture file. Only the levels from
+// the resident base level down to the smallest are allocated and uploaded. The
+// file stays mapped, finer levels stream in one per update while the wanted
+// level is finer, coarser ones are dropped as soon as they are no longer needed.
+// A change of the resident range replaces the image, the version tells which
+// descriptor sets still point at an older one.
+class StreamingTexture
+{
+private:
+	MappedTextureFile m_file;
+	Texture m_texture;
+	uint32_t m_residentLevel = 0;
+	uint32_t m_tailLevel = 0;
+	float m_wantedLevel = 0.0f;
+	uint32_t m_version = 0;
+
+public:
+	bool create(LibGFX::VkContext& context, TransferQueue& transferQueue, const std::string& path, uint32_t tailSize = 128);
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastValue);
+	float calculateLevel(float screenSize) const;
+	void request(float level) { m_wantedLevel = level; }
+	bool update(LibGFX::VkContext& context, TransferQueue& transferQueue, DeletionQueue& deletionQueue, uint64_t lastValue);
+	const Texture& getTexture() const { return m_texture; }
+	uint32_t getResidentLevel() const { return m_residentLevel; }
+	uint32_t getLevelCount() const { return m_file.getLevelCount(); }
+	uint32_t getVersion() const { return m_version; }
+	bool isCreated() const { return m_texture.image != VK_NULL_HANDLE; }
+};
@@ -0,0 +1,203 @@
+#include "Texture.h"
+#include <stdexcept>
+#include <algorithm>
+
+static bool findMemoryTypeIndex(LibGFX::VkContext& context, uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& index)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(context.getPhysicalDevice(), &memoryProperties);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			index = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t findMemoryType(LibGFX::VkContext& context, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	uint32_t index;
+	if (!findMemoryTypeIndex(context, typeFilter, properties, index)) {
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+	return index;
+}
+
+// Image, memory and a view over all mip levels. Lazily allocated memory falls back to device local
+// memory on devices without such a memory type.
+static Texture createImage(LibGFX::VkContext& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkMemoryPropertyFlags memoryProperties, VkSampleCountFlagBits samples)
+{
+	VkDevice device = context.getDevice();
+
+	Texture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = mipLevels;
+
+	// Image
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = samples;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture image!");
+	}
+
+	// Memory
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, texture.image, &memoryRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memoryRequirements.size;
+	if (!findMemoryTypeIndex(context, memoryRequirements.memoryTypeBits, memoryProperties, allocInfo.memoryTypeIndex)) {
+		memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		allocInfo.memoryTypeIndex = findMemoryType(context, memoryRequirements.memoryTypeBits, memoryProperties);
+	}
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &texture.memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate texture image memory!");
+	}
+	texture.memoryProperties = memoryProperties;
+	vkBindImageMemory(device, texture.image, texture.memory, 0);
+	texture.size = memoryRequirements.size;
+
+	// Image View
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = aspect;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &viewInfo, nullptr, &texture.imageView) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture image view!");
+	}
+
+	return texture;
+}
+
+Texture createTexture(LibGFX::VkContext& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage)
+{
+	return createImage(context, width, height, mipLevels, format, usage, VK_IMAGE_ASPECT_COLOR_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT);
+}
+
+Texture createAttachment(LibGFX::VkContext& context, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples)
+{
+	// Transient attachments never leave tile memory on tile based GPUs, lazily allocated memory is then never backed
+	VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0) {
+		memoryProperties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+	return createImage(context, width, height, 1, format, usage, getAspectMask(format), memoryProperties, samples);
+}
+
+void destroyTexture(LibGFX::VkContext& context, Texture& texture)
+{
+	VkDevice device = context.getDevice();
+	vkDestroyImageView(device, texture.imageView, nullptr);
+	vkDestroyImage(device, texture.image, nullptr);
+	vkFreeMemory(device, texture.memory, nullptr);
+	texture = Texture();
+}
+
+VkFormat getVkFormat(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case TextureFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+	case TextureFormat::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+	case TextureFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureFormat::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+	default: return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+bool hasStencilComponent(VkFormat format)
+{
+	return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+uint32_t getAttachmentFormatSize(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+		return 2;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+		return 3;
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return 5;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+VkImageAspectFlags getAspectMask(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+bool isSampledFormatSupported(LibGFX::VkContext& context, VkFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(context.getPhysicalDevice(), format, &properties);
+	return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+VkSamplerCreateInfo getMipmappedSamplerInfo(LibGFX::VkContext& context, bool anisotropy, float maxAnisotropy)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &properties);
+
+	// Trilinear filtering over the whole mip chain. The LOD is not clamped to a level count,
+	// the image view limits it, so textures with different mip chains share the sampler.
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = anisotropy ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = anisotropy ? std::min(maxAnisotropy, properties.limits.maxSamplerAnisotropy) : 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	return samplerInfo;
+}
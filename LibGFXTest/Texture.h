@@ -0,0 +1,33 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include "VkContext.h"
+#include "BlockCompression.h"
+
+// Sampled 2D image owned by the application (image, memory and view)
+struct Texture
+{
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipLevels = 1;
+	VkDeviceSize size = 0;
+	VkMemoryPropertyFlags memoryProperties = 0;
+};
+
+uint32_t findMemoryType(LibGFX::VkContext& context, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+Texture createTexture(LibGFX::VkContext& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage);
+// Single level color or depth attachment, the view aspect follows the format. With TRANSIENT_ATTACHMENT
+// usage the image is placed in lazily allocated memory where the device has it.
+Texture createAttachment(LibGFX::VkContext& context, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+void destroyTexture(LibGFX::VkContext& context, Texture& texture);
+VkFormat getVkFormat(TextureFormat format);
+bool hasStencilComponent(VkFormat format);
+VkImageAspectFlags getAspectMask(VkFormat format);
+// Bytes per texel of the common color and depth attachment formats
+uint32_t getAttachmentFormatSize(VkFormat format);
+bool isSampledFormatSupported(LibGFX::VkContext& context, VkFormat format);
+VkSamplerCreateInfo getMipmappedSamplerInfo(LibGFX::VkContext& context, bool anisotropy, float maxAnisotropy);
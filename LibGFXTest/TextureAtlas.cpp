@@ -0,0 +1,360 @@
+#include "TextureAtlas.h"
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+static bool overlaps(uint32_t ax, uint32_t ay, uint32_t aw, uint32_t ah, uint32_t bx, uint32_t by, uint32_t bw, uint32_t bh)
+{
+	return ax < bx + bw && bx < ax + aw && ay < by + bh && by < ay + ah;
+}
+
+void TextureAtlas::create(LibGFX::VkContext& context, uint32_t width, uint32_t height, uint32_t padding)
+{
+	// A single level, mips would bleed neighbouring sub-images into each other
+	m_texture = createTexture(context, width, height, 1, VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	m_padding = padding;
+	m_initialized = false;
+	m_freeRects = { { 0, 0, width, height } };
+
+	m_stop = false;
+	m_worker = std::thread(&TextureAtlas::workerLoop, this);
+}
+
+void TextureAtlas::destroy(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+
+	deletionQueue.destroyTexture(lastValue, m_texture);
+	m_texture = Texture();
+	m_freeRects.clear();
+	m_regions.clear();
+	m_allocations.clear();
+	m_freeHandles.clear();
+	m_pendingCopies.clear();
+}
+
+std::future<std::vector<TextureAtlas::Handle>> TextureAtlas::insert(std::vector<LibGFX::ImageData> images)
+{
+	// The pixels have to stay valid until the future is ready
+	Job job;
+	job.images = std::move(images);
+	auto result = job.result.get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+	return result;
+}
+
+void TextureAtlas::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+		if (m_stop) {
+			break;
+		}
+
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+		try {
+			job.result.set_value(pack(job.images));
+		}
+		catch (...) {
+			job.result.set_exception(std::current_exception());
+		}
+		lock.lock();
+	}
+
+	// Batches not packed yet are abandoned, their futures report a broken promise
+	m_jobs.clear();
+}
+
+std::vector<TextureAtlas::Handle> TextureAtlas::pack(const std::vector<LibGFX::ImageData>& images)
+{
+	for (const auto& image : images) {
+		if (image.format != m_texture.format) {
+			throw std::runtime_error("atlas images have to be RGBA8!");
+		}
+	}
+
+	// Larger images first pack tighter, handles are returned in input order
+	std::vector<size_t> order(images.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+		return std::max(images[a].width, images[a].height) > std::max(images[b].width, images[b].height);
+	});
+
+	std::vector<Handle> handles(images.size(), InvalidHandle);
+	std::vector<Rect> rects(images.size());
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_freeRectsDirty) {
+			rebuildFreeRects();
+		}
+		for (size_t i : order) {
+			// Padding on the right and bottom keeps bilinear filtering inside the sub-image
+			Rect rect;
+			if (!findPosition(images[i].width + m_padding, images[i].height + m_padding, rect)) {
+				continue;
+			}
+			placeRect(rect);
+
+			Handle handle;
+			if (!m_freeHandles.empty()) {
+				handle = m_freeHandles.back();
+				m_freeHandles.pop_back();
+			}
+			else {
+				handle = static_cast<Handle>(m_regions.size());
+				m_regions.emplace_back();
+				m_allocations.emplace_back();
+			}
+
+			Region& region = m_regions[handle];
+			region.x = rect.x;
+			region.y = rect.y;
+			region.width = images[i].width;
+			region.height = images[i].height;
+			region.u0 = static_cast<float>(rect.x) / m_texture.width;
+			region.v0 = static_cast<float>(rect.y) / m_texture.height;
+			region.u1 = static_cast<float>(rect.x + images[i].width) / m_texture.width;
+			region.v1 = static_cast<float>(rect.y + images[i].height) / m_texture.height;
+			m_allocations[handle] = rect;
+			handles[i] = handle;
+			rects[i] = { rect.x, rect.y, images[i].width, images[i].height };
+		}
+	}
+
+	// Copy the pixels outside the lock, the copies are recorded with the next frame
+	std::vector<PendingCopy> copies;
+	for (size_t i = 0; i < images.size(); i++) {
+		if (handles[i] == InvalidHandle) {
+			continue;
+		}
+		const uint8_t* pixels = static_cast<const uint8_t*>(images[i].pixels);
+		PendingCopy copy;
+		copy.handle = handles[i];
+		copy.rect = rects[i];
+		copy.pixels.assign(pixels, pixels + static_cast<size_t>(images[i].width) * images[i].height * 4);
+		copies.push_back(std::move(copy));
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& copy : copies) {
+		m_pendingCopies.push_back(std::move(copy));
+	}
+	return handles;
+}
+
+void TextureAtlas::remove(Handle handle)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// A copy not recorded yet would overlap the next image placed here
+	m_pendingCopies.erase(std::remove_if(m_pendingCopies.begin(), m_pendingCopies.end(), [handle](const PendingCopy& copy) {
+		return copy.handle == handle;
+	}), m_pendingCopies.end());
+
+	// The area is free again once the free rectangles are rebuilt before the next packing.
+	// Frames in flight may still sample it, a new image is only written after the barrier
+	// in a later command buffer.
+	m_allocations[handle] = {};
+	m_freeRectsDirty = true;
+	m_regions[handle] = Region();
+	m_freeHandles.push_back(handle);
+}
+
+TextureAtlas::Region TextureAtlas::getRegion(Handle handle)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_regions[handle];
+}
+
+bool TextureAtlas::findPosition(uint32_t width, uint32_t height, Rect& rect) const
+{
+	// Best short side fit, ties broken by the long side
+	bool found = false;
+	uint32_t bestShortSide = UINT32_MAX;
+	uint32_t bestLongSide = UINT32_MAX;
+	for (const auto& freeRect : m_freeRects) {
+		if (freeRect.width < width || freeRect.height < height) {
+			continue;
+		}
+		uint32_t leftoverX = freeRect.width - width;
+		uint32_t leftoverY = freeRect.height - height;
+		uint32_t shortSide = std::min(leftoverX, leftoverY);
+		uint32_t longSide = std::max(leftoverX, leftoverY);
+		if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide)) {
+			rect = { freeRect.x, freeRect.y, width, height };
+			bestShortSide = shortSide;
+			bestLongSide = longSide;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void TextureAtlas::placeRect(const Rect& rect)
+{
+	// Split every free rectangle the new one overlaps into the maximal parts around it
+	size_t keptCount = 0;
+	std::vector<Rect> splitRects;
+	for (const auto& freeRect : m_freeRects) {
+		if (!overlaps(freeRect.x, freeRect.y, freeRect.width, freeRect.height, rect.x, rect.y, rect.width, rect.height)) {
+			m_freeRects[keptCount++] = freeRect;
+			continue;
+		}
+		if (rect.x > freeRect.x) {
+			splitRects.push_back({ freeRect.x, freeRect.y, rect.x - freeRect.x, freeRect.height });
+		}
+		if (rect.x + rect.width < freeRect.x + freeRect.width) {
+			splitRects.push_back({ rect.x + rect.width, freeRect.y, freeRect.x + freeRect.width - (rect.x + rect.width), freeRect.height });
+		}
+		if (rect.y > freeRect.y) {
+			splitRects.push_back({ freeRect.x, freeRect.y, freeRect.width, rect.y - freeRect.y });
+		}
+		if (rect.y + rect.height < freeRect.y + freeRect.height) {
+			splitRects.push_back({ freeRect.x, rect.y + rect.height, freeRect.width, freeRect.y + freeRect.height - (rect.y + rect.height) });
+		}
+	}
+	m_freeRects.resize(keptCount);
+
+	// Kept rectangles are maximal, only the split parts can be contained in another one
+	auto contains = [](const Rect& outer, const Rect& inner) {
+		return inner.x >= outer.x && inner.y >= outer.y &&
+			inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+	};
+	for (size_t i = 0; i < splitRects.size(); i++) {
+		bool contained = std::any_of(m_freeRects.begin(), m_freeRects.begin() + keptCount, [&](const Rect& freeRect) {
+			return contains(freeRect, splitRects[i]);
+		});
+		for (size_t j = 0; j < splitRects.size() && !contained; j++) {
+			// Of two equal parts the later one goes
+			contained = i != j && contains(splitRects[j], splitRects[i]) && (!contains(splitRects[i], splitRects[j]) || j < i);
+		}
+		if (!contained) {
+			m_freeRects.push_back(splitRects[i]);
+		}
+	}
+}
+
+void TextureAtlas::rebuildFreeRects()
+{
+	// Removed areas merge with their free neighbours again, starting over from the live allocations
+	m_freeRects = { { 0, 0, m_texture.width, m_texture.height } };
+	for (const auto& allocation : m_allocations) {
+		if (allocation.width > 0) {
+			placeRect(allocation);
+		}
+	}
+	m_freeRectsDirty = false;
+}
+
+void TextureAtlas::recordUpdates(LibGFX::VkContext& context, VkCommandBuffer commandBuffer, DeletionQueue& deletionQueue, uint64_t frameValue)
+{
+	std::vector<PendingCopy> copies;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		copies.swap(m_pendingCopies);
+	}
+	if (copies.empty() && m_initialized) {
+		return;
+	}
+
+	// All copies of the frame share one staging buffer, released once the frame completed
+	VkDeviceSize stagingSize = 0;
+	for (const auto& copy : copies) {
+		stagingSize += copy.pixels.size();
+	}
+
+	LibGFX::Buffer stagingBuffer;
+	std::vector<VkBufferImageCopy> regions;
+	if (stagingSize > 0) {
+		stagingBuffer = context.createBuffer(
+			stagingSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		);
+		void* mapped = nullptr;
+		if (vkMapMemory(context.getDevice(), stagingBuffer.memory, 0, stagingSize, 0, &mapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map atlas staging buffer!");
+		}
+
+		VkDeviceSize offset = 0;
+		for (const auto& copy : copies) {
+			std::memcpy(static_cast<uint8_t*>(mapped) + offset, copy.pixels.data(), copy.pixels.size());
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { static_cast<int32_t>(copy.rect.x), static_cast<int32_t>(copy.rect.y), 0 };
+			region.imageExtent = { copy.rect.width, copy.rect.height, 1 };
+			regions.push_back(region);
+			offset += copy.pixels.size();
+		}
+		vkUnmapMemory(context.getDevice(), stagingBuffer.memory);
+		deletionQueue.destroyBuffer(frameValue, stagingBuffer);
+	}
+
+	VkImageSubresourceRange range = {};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = 1;
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	// Shader read -> transfer destination, waits for earlier frames sampling the atlas.
+	// The first update starts from undefined contents and clears the whole atlas.
+	VkImageMemoryBarrier toTransfer = {};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.oldLayout = m_initialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = m_texture.image;
+	toTransfer.subresourceRange = range;
+	toTransfer.srcAccessMask = 0;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	if (!m_initialized) {
+		VkClearColorValue clearColor = {};
+		vkCmdClearColorImage(commandBuffer, m_texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+		m_initialized = true;
+
+		// The clear and the copies write the same texels
+		VkMemoryBarrier clearBarrier = {};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (!regions.empty()) {
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.buffer, m_texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	// Transfer destination -> shader read for this and later frames
+	VkImageMemoryBarrier toShader = toTransfer;
+	toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	toShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShader);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "VkContext.h"
+#include "Imaging.h"
+#include "Texture.h"
+#include "DeletionQueue.h"
+
+// Packs many small RGBA8 images into one atlas texture so they share a single
+// image, view and descriptor set. Placement uses MaxRects (best short side fit)
+// on a worker thread, sub-images can be inserted and removed at runtime. Pixel
+// copies are recorded into the frame's graphics command buffer, the barrier in
+// front of them orders the writes after reads of earlier frames.
+class TextureAtlas
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = UINT32_MAX;
+
+	// Texel rectangle and normalized texture coordinates of a sub-image
+	struct Region
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		float u0 = 0.0f;
+		float v0 = 0.0f;
+		float u1 = 0.0f;
+		float v1 = 0.0f;
+	};
+
+private:
+	struct Rect
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct Job
+	{
+		std::vector<LibGFX::ImageData> images;
+		std::promise<std::vector<Handle>> result;
+	};
+
+	struct PendingCopy
+	{
+		Handle handle;
+		Rect rect;
+		std::vector<uint8_t> pixels;
+	};
+
+	Texture m_texture;
+	uint32_t m_padding = 1;
+	bool m_initialized = false;
+	bool m_freeRectsDirty = false;
+	std::vector<Rect> m_freeRects;
+	std::vector<Region> m_regions;
+	std::vector<Rect> m_allocations;
+	std::vector<Handle> m_freeHandles;
+	std::vector<PendingCopy> m_pendingCopies;
+	std::mutex m_mutex;
+	std::thread m_worker;
+	std::condition_variable m_wake;
+	std::deque<Job> m_jobs;
+	bool m_stop = false;
+
+	void workerLoop();
+	std::vector<Handle> pack(const std::vector<LibGFX::ImageData>& images);
+	bool findPosition(uint32_t width, uint32_t height, Rect& rect) const;
+	void placeRect(const Rect& rect);
+	void rebuildFreeRects();
+
+public:
+	void create(LibGFX::VkContext& context, uint32_t width, uint32_t height, uint32_t padding = 1);
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastValue);
+	std::future<std::vector<Handle>> insert(std::vector<LibGFX::ImageData> images);
+	void remove(Handle handle);
+	Region getRegion(Handle handle);
+	void recordUpdates(LibGFX::VkContext& context, VkCommandBuffer commandBuffer, DeletionQueue& deletionQueue, uint64_t frameValue);
+	const Texture& getTexture() const { return m_texture; }
+};
@@ -0,0 +1,154 @@
+#include "TextureCache.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+void TextureCache::create(LibGFX::VkContext& context, Loader loader, VkDeviceSize budget)
+{
+	if (!loader) {
+		throw std::runtime_error("texture cache needs a loader!");
+	}
+	m_loader = std::move(loader);
+	m_budget = budget;
+
+	// The budget query is physical device functionality, support is enough to chain the struct
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(context.getPhysicalDevice(), nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(context.getPhysicalDevice(), nullptr, &extensionCount, extensions.data());
+	m_memoryBudgetSupported = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension) {
+		return std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+	});
+}
+
+void TextureCache::destroy(DeletionQueue& deletionQueue, uint64_t lastValue)
+{
+	for (auto& entry : m_entries) {
+		if (entry.resident) {
+			deletionQueue.destroyTexture(lastValue, entry.texture);
+		}
+	}
+	m_entries.clear();
+	m_handles.clear();
+	m_residentSize = 0;
+	m_releasingSize = 0;
+	m_pendingReleases.clear();
+	m_loader = nullptr;
+}
+
+TextureCache::Handle TextureCache::add(const std::string& path)
+{
+	auto it = m_handles.find(path);
+	if (it != m_handles.end()) {
+		return it->second;
+	}
+
+	// Registered only, the texture is loaded on first use
+	Handle handle = static_cast<Handle>(m_entries.size());
+	Entry entry;
+	entry.path = path;
+	m_entries.push_back(std::move(entry));
+	m_handles.emplace(path, handle);
+	return handle;
+}
+
+const Texture& TextureCache::use(Handle handle, uint64_t frameValue)
+{
+	Entry& entry = m_entries[handle];
+	if (!entry.resident) {
+		entry.texture = m_loader(entry.path);
+		entry.resident = true;
+		entry.version++;
+		m_residentSize += entry.texture.size;
+	}
+	entry.lastUsedValue = std::max(entry.lastUsedValue, frameValue);
+	return entry.texture;
+}
+
+void TextureCache::trim(LibGFX::VkContext& context, DeletionQueue& deletionQueue, uint64_t frameValue, uint64_t completedValue)
+{
+	// Evicted textures count against the heap usage until the deletion queue destroyed them
+	auto released = std::remove_if(m_pendingReleases.begin(), m_pendingReleases.end(), [&](const PendingRelease& release) {
+		if (release.value > completedValue) {
+			return false;
+		}
+		m_releasingSize -= release.size;
+		return true;
+	});
+	m_pendingReleases.erase(released, m_pendingReleases.end());
+
+	VkDeviceSize budget = getBudget(context);
+	if (m_residentSize <= budget) {
+		return;
+	}
+
+	// Textures used by the frame being recorded stay, older ones go oldest first
+	std::vector<Handle> candidates;
+	for (Handle handle = 0; handle < m_entries.size(); handle++) {
+		if (m_entries[handle].resident && m_entries[handle].lastUsedValue < frameValue) {
+			candidates.push_back(handle);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](Handle a, Handle b) {
+		return m_entries[a].lastUsedValue < m_entries[b].lastUsedValue;
+	});
+
+	// Candidates were last used by submitted frames, tagging them with the last submitted
+	// value keeps the deletion queue sorted
+	uint64_t releaseValue = frameValue - 1;
+	for (Handle handle : candidates) {
+		if (m_residentSize <= budget) {
+			break;
+		}
+
+		Entry& entry = m_entries[handle];
+		m_residentSize -= entry.texture.size;
+		m_releasingSize += entry.texture.size;
+		m_pendingReleases.push_back({ releaseValue, entry.texture.size });
+		deletionQueue.destroyTexture(releaseValue, entry.texture);
+		entry.texture = Texture();
+		entry.resident = false;
+	}
+}
+
+VkDeviceSize TextureCache::getBudget(LibGFX::VkContext& context) const
+{
+	VkDeviceSize budget = m_budget > 0 ? m_budget : std::numeric_limits<VkDeviceSize>::max();
+	return std::min(budget, queryDeviceBudget(context));
+}
+
+VkDeviceSize TextureCache::queryDeviceBudget(LibGFX::VkContext& context) const
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties.pNext = m_memoryBudgetSupported ? &budgetProperties : nullptr;
+	vkGetPhysicalDeviceMemoryProperties2(context.getPhysicalDevice(), &memoryProperties);
+
+	// Textures live in device local memory, sum the heaps they can be placed in
+	VkDeviceSize heapSize = 0;
+	VkDeviceSize heapBudget = 0;
+	VkDeviceSize heapUsage = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++) {
+		if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			heapSize += memoryProperties.memoryProperties.memoryHeaps[i].size;
+			heapBudget += budgetProperties.heapBudget[i];
+			heapUsage += budgetProperties.heapUsage[i];
+		}
+	}
+
+	if (!m_memoryBudgetSupported) {
+		// Without an estimate of other processes keep textures to half of the heap
+		return heapSize / 2;
+	}
+
+	// The budget is shared with every other allocation of the process and is only an estimate,
+	// leave 10% headroom and subtract what is not owned by the cache
+	VkDeviceSize available = heapBudget - heapBudget / 10;
+	VkDeviceSize ownedSize = m_residentSize + m_releasingSize;
+	VkDeviceSize otherUsage = heapUsage > ownedSize ? heapUsage - ownedSize : 0;
+	return available > otherUsage ? available - otherUsage : 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include "VkContext.h"
+#include "Texture.h"
+#include "DeletionQueue.h"
+
+// Keeps textures loaded from disk resident within a VRAM budget. Every use tags
+// the texture with the frame timeline value, when the resident size exceeds the
+// budget the least recently used textures are released through the deletion
+// queue and loaded again the next time they are used. The budget is the
+// configured limit, clamped to the VK_EXT_memory_budget estimate when available.
+class TextureCache
+{
+public:
+	using Handle = uint32_t;
+	using Loader = std::function<Texture(const std::string& path)>;
+
+private:
+	struct Entry
+	{
+		std::string path;
+		Texture texture;
+		uint64_t lastUsedValue = 0;
+		uint32_t version = 0;	// Incremented on every load, views of older versions are stale
+		bool resident = false;
+	};
+
+	struct PendingRelease
+	{
+		uint64_t value;
+		VkDeviceSize size;
+	};
+
+	Loader m_loader;
+	VkDeviceSize m_budget = 0;
+	VkDeviceSize m_residentSize = 0;
+	VkDeviceSize m_releasingSize = 0;
+	std::vector<PendingRelease> m_pendingReleases;
+	bool m_memoryBudgetSupported = false;
+	std::vector<Entry> m_entries;
+	std::unordered_map<std::string, Handle> m_handles;
+
+	VkDeviceSize queryDeviceBudget(LibGFX::VkContext& context) const;
+
+public:
+	void create(LibGFX::VkContext& context, Loader loader, VkDeviceSize budget = 0);
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastValue);
+	Handle add(const std::string& path);
+	const Texture& use(Handle handle, uint64_t frameValue);
+	void trim(LibGFX::VkContext& context, DeletionQueue& deletionQueue, uint64_t frameValue, uint64_t completedValue);
+	uint32_t getVersion(Handle handle) const { return m_entries[handle].version; }
+	bool isResident(Handle handle) const { return m_entries[handle].resident; }
+	VkDeviceSize getResidentSize() const { return m_residentSize; }
+	VkDeviceSize getBudget(LibGFX::VkContext& context) const;
+};
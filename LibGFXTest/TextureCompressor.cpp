@@ -0,0 +1,152 @@
+// TextureCompressor.cpp: Offline tool which bakes images into block compressed texture files.
+//
+#define STB_IMAGE_IMPLEMENTATION
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "stb_image.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "TextureFile.h"
+#include "LZCompression.h"
+#include "ThreadPool.h"
+
+static bool parseFormat(const std::string& name, TextureFormat& format)
+{
+	if (name == "rgba8") format = TextureFormat::RGBA8;
+	else if (name == "bc1") format = TextureFormat::BC1;
+	else if (name == "bc3") format = TextureFormat::BC3;
+	else if (name == "bc4") format = TextureFormat::BC4;
+	else if (name == "bc5") format = TextureFormat::BC5;
+	else if (name == "bc7") format = TextureFormat::BC7;
+	else return false;
+	return true;
+}
+
+static void printUsage()
+{
+	std::cerr << "Usage: TextureCompressor <input image> <output.gtex> [rgba8|bc1|bc3|bc4|bc5|bc7] [--no-mips] [--lz] [--threads N]" << std::endl;
+}
+
+// Parses a thread count, 0 picks one thread per core
+static bool parseThreadCount(const char* text, uint32_t& threadCount)
+{
+	if (text[0] < '0' || text[0] > '9') return false;
+	try {
+		size_t end = 0;
+		unsigned long value = std::stoul(text, &end);
+		if (text[end] != '\0' || value > UINT32_MAX) return false;
+		threadCount = static_cast<uint32_t>(value);
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printUsage();
+		return -1;
+	}
+
+	std::string inputPath = argv[1];
+	std::string outputPath = argv[2];
+	bool hasFormat = false;
+	bool generateMips = true;
+	bool supercompress = false;
+	uint32_t threadCount = 0;
+	TextureFormat format = TextureFormat::BC1;
+
+	for (int i = 3; i < argc; i++) {
+		if (std::strcmp(argv[i], "--no-mips") == 0) {
+			generateMips = false;
+		}
+		else if (std::strcmp(argv[i], "--lz") == 0) {
+			supercompress = true;
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0) {
+			if (i + 1 >= argc || !parseThreadCount(argv[i + 1], threadCount)) {
+				std::cerr << "Invalid thread count for --threads" << std::endl;
+				printUsage();
+				return -1;
+			}
+			i++;
+		}
+		else if (parseFormat(argv[i], format)) {
+			hasFormat = true;
+		}
+		else {
+			std::cerr << "Unknown argument: " << argv[i] << std::endl;
+			printUsage();
+			return -1;
+		}
+	}
+
+	// Decode the source image, always expanded to RGBA for the encoders. Large JPEGs decode on all threads.
+	ThreadPool decodePool;
+	decodePool.create(threadCount);
+	stbi_set_parallel_for(ThreadPool::parallelForCallback, &decodePool, static_cast<int>(decodePool.getThreadCount()));
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(inputPath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	stbi_set_parallel_for(nullptr, nullptr, 1);
+	decodePool.destroy();
+	if (!pixels) {
+		std::cerr << "Failed to load " << inputPath << ": " << stbi_failure_reason() << std::endl;
+		return -1;
+	}
+
+	// Images without alpha (e.g. JPEGs) only need the RGB format
+	if (!hasFormat) {
+		format = (channels == 4 || channels == 2) ? TextureFormat::BC7 : TextureFormat::BC1;
+	}
+
+	uint32_t mipLevels = generateMips ? calculateMipLevels(width, height) : 1;
+	auto mipChain = calculateMipChain(width, height, 4, mipLevels);
+	std::vector<uint8_t> uncompressed(mipChain.back().offset + mipChain.back().size);
+	generateMipChainRGBA8(pixels, mipChain, uncompressed.data());
+	stbi_image_free(pixels);
+
+	// Compress every level, stored smallest first so coarse levels can be read before fine ones
+	TextureFileData textureData;
+	textureData.format = format;
+	textureData.supercompression = supercompress ? Supercompression::LZ : Supercompression::None;
+	textureData.width = static_cast<uint32_t>(width);
+	textureData.height = static_cast<uint32_t>(height);
+	textureData.levels.resize(mipLevels);
+
+	const uint64_t alignMask = TEXTURE_FILE_ALIGNMENT - 1;
+	uint64_t uploadOffset = 0;
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> packed;
+	for (uint32_t i = mipLevels; i-- > 0;) {
+		const auto& level = mipChain[i];
+		compressed.resize(getLevelSize(format, level.width, level.height));
+		compressImage(uncompressed.data() + level.offset, level.width, level.height, format, compressed.data(), threadCount);
+
+		TextureFileLevel& fileLevel = textureData.levels[i];
+		fileLevel.uploadOffset = uploadOffset;
+		fileLevel.uploadSize = compressed.size();
+		uploadOffset = (uploadOffset + compressed.size() + alignMask) & ~alignMask;
+
+		// Without supercompression stored offsets equal upload offsets
+		const std::vector<uint8_t>* stored = &compressed;
+		if (supercompress) {
+			lzCompress(compressed.data(), compressed.size(), packed);
+			stored = &packed;
+		}
+		fileLevel.offset = (textureData.data.size() + alignMask) & ~alignMask;
+		fileLevel.size = stored->size();
+		textureData.data.resize(fileLevel.offset);
+		textureData.data.insert(textureData.data.end(), stored->begin(), stored->end());
+	}
+
+	writeTextureFile(outputPath, textureData);
+	std::cout << "Wrote " << outputPath << " (" << width << "x" << height << ", " << mipLevels << " levels, "
+		<< textureData.data.size() << " bytes)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include "TextureFile.h"
+#include "LZCompression.h"
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void writeTextureFile(const std::string& path, const TextureFileData& textureData)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to create texture file!");
+	}
+
+	TextureFileHeader header = {};
+	header.magic = TEXTURE_FILE_MAGIC;
+	header.version = TEXTURE_FILE_VERSION;
+	header.format = static_cast<uint32_t>(textureData.format);
+	header.width = textureData.width;
+	header.height = textureData.height;
+	header.levelCount = static_cast<uint32_t>(textureData.levels.size());
+	header.supercompression = static_cast<uint32_t>(textureData.supercompression);
+	header.dataSize = textureData.data.size();
+
+	// Level data starts aligned behind the level table
+	size_t tableEnd = sizeof(header) + sizeof(TextureFileLevel) * textureData.levels.size();
+	header.dataOffset = (tableEnd + TEXTURE_FILE_ALIGNMENT - 1) & ~static_cast<uint64_t>(TEXTURE_FILE_ALIGNMENT - 1);
+	for (const auto& level : textureData.levels) {
+		header.uploadSize = std::max<uint64_t>(header.uploadSize, level.uploadOffset + level.uploadSize);
+	}
+
+	std::vector<char> padding(header.dataOffset - tableEnd, 0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(textureData.levels.data()), sizeof(TextureFileLevel) * textureData.levels.size());
+	file.write(padding.data(), padding.size());
+	file.write(reinterpret_cast<const char*>(textureData.data.data()), textureData.data.size());
+	if (!file) {
+		throw std::runtime_error("failed to write texture file!");
+	}
+}
+
+bool MappedTextureFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	m_file = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	m_mappingSize = static_cast<size_t>(fileSize.QuadPart);
+
+	m_fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_fileMapping) {
+		close();
+		return false;
+	}
+	m_mapping = static_cast<const uint8_t*>(MapViewOfFile(m_fileMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_file = ::open(path.c_str(), O_RDONLY);
+	if (m_file < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_file, &fileStat) != 0 || fileStat.st_size == 0) {
+		close();
+		return false;
+	}
+	m_mappingSize = static_cast<size_t>(fileStat.st_size);
+
+	void* mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, m_file, 0);
+	m_mapping = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+	if (m_mapping) {
+		madvise(mapping, m_mappingSize, MADV_SEQUENTIAL);
+	}
+#endif
+	if (!m_mapping) {
+		close();
+		return false;
+	}
+
+	// Validate header and level table against the mapped size. Bounds are checked as
+	// offset <= limit && size <= limit - offset so hostile values cannot wrap around.
+	m_header = reinterpret_cast<const TextureFileHeader*>(m_mapping);
+	if (m_mappingSize < sizeof(TextureFileHeader) || m_header->magic != TEXTURE_FILE_MAGIC || m_header->version != TEXTURE_FILE_VERSION ||
+		m_header->format > static_cast<uint32_t>(TextureFormat::BC7) || m_header->supercompression > static_cast<uint32_t>(Supercompression::LZ) ||
+		m_header->width == 0 || m_header->height == 0 || m_header->levelCount == 0 ||
+		m_header->levelCount > calculateMipLevels(m_header->width, m_header->height) ||
+		sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * m_header->levelCount > m_header->dataOffset ||
+		m_header->dataOffset > m_mappingSize || m_header->dataSize > m_mappingSize - m_header->dataOffset) {
+		close();
+		return false;
+	}
+	// Plain files upload with one memcpy of the upload range from the level data
+	bool plain = getSupercompression() == Supercompression::None;
+	if (plain && m_header->uploadSize > m_header->dataSize) {
+		close();
+		return false;
+	}
+	m_levels = reinterpret_cast<const TextureFileLevel*>(m_mapping + sizeof(TextureFileHeader));
+	for (uint32_t i = 0; i < m_header->levelCount; i++) {
+		// Every level has to hold exactly the texels of its mip, decodeLevel writes uploadSize bytes
+		const TextureFileLevel& level = m_levels[i];
+		uint32_t width = std::max(m_header->width >> i, 1u);
+		uint32_t height = std::max(m_header->height >> i, 1u);
+		bool stored = !plain || (level.size == level.uploadSize && level.offset == level.uploadOffset);
+		if (level.uploadSize != getLevelSize(getFormat(), width, height) || !stored ||
+			level.offset > m_header->dataSize || level.size > m_header->dataSize - level.offset ||
+			level.uploadOffset > m_header->uploadSize || level.uploadSize > m_header->uploadSize - level.uploadOffset) {
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MappedTextureFile::close()
+{
+#ifdef _WIN32
+	if (m_mapping) UnmapViewOfFile(m_mapping);
+	if (m_fileMapping) CloseHandle(m_fileMapping);
+	if (m_file) CloseHandle(m_file);
+	m_fileMapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_mapping) munmap(const_cast<uint8_t*>(m_mapping), m_mappingSize);
+	if (m_file >= 0) ::close(m_file);
+	m_file = -1;
+#endif
+	m_mapping = nullptr;
+	m_mappingSize = 0;
+	m_header = nullptr;
+	m_levels = nullptr;
+}
+
+bool MappedTextureFile::decodeLevel(uint32_t level, uint8_t* dst) const
+{
+	const TextureFileLevel& entry = m_levels[level];
+	if (getSupercompression() == Supercompression::LZ) {
+		return lzDecompress(getLevelData(level), entry.size, dst, entry.uploadSize);
+	}
+	std::memcpy(dst, getLevelData(level), entry.uploadSize);
+	return true;
+}
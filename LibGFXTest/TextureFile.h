@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+
+// Baked texture file (KTX2-like): header, one entry per mip level, then the level data.
+// Levels are stored smallest first, already laid out the way they are copied into the
+// staging buffer, so uncompressed files upload with a single memcpy from the mapping.
+constexpr uint32_t TEXTURE_FILE_MAGIC = 0x58455447; // "GTEX"
+constexpr uint32_t TEXTURE_FILE_VERSION = 2;
+constexpr uint32_t TEXTURE_FILE_ALIGNMENT = 16;
+
+enum class Supercompression : uint32_t
+{
+	None = 0,
+	LZ = 1		// per level LZ77 (see LZCompression)
+};
+
+struct TextureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t supercompression;
+	uint32_t reserved;
+	uint64_t dataOffset;	// start of the level data in the file
+	uint64_t dataSize;		// stored bytes of all levels
+	uint64_t uploadSize;	// staging bytes needed for all levels
+};
+
+struct TextureFileLevel
+{
+	uint64_t offset;		// stored data, relative to dataOffset
+	uint64_t size;			// stored bytes
+	uint64_t uploadOffset;	// position in the staging buffer
+	uint64_t uploadSize;	// bytes after supercompression was undone
+};
+
+// Writer side, used by the TextureCompressor tool
+struct TextureFileData
+{
+	TextureFormat format = TextureFormat::RGBA8;
+	Supercompression supercompression = Supercompression::None;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<TextureFileLevel> levels;
+	std::vector<uint8_t> data;
+};
+
+void writeTextureFile(const std::string& path, const TextureFileData& textureData);
+
+// Reader side, the file stays memory mapped while the texture is uploaded
+class MappedTextureFile
+{
+private:
+	const uint8_t* m_mapping = nullptr;
+	size_t m_mappingSize = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_fileMapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+	const TextureFileHeader* m_header = nullptr;
+	const TextureFileLevel* m_levels = nullptr;
+
+public:
+	MappedTextureFile() = default;
+	MappedTextureFile(const MappedTextureFile&) = delete;
+	MappedTextureFile& operator=(const MappedTextureFile&) = delete;
+	~MappedTextureFile() { close(); }
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return m_mapping != nullptr; }
+	TextureFormat getFormat() const { return static_cast<TextureFormat>(m_header->format); }
+	Supercompression getSupercompression() const { return static_cast<Supercompression>(m_header->supercompression); }
+	uint32_t getWidth() const { return m_header->width; }
+	uint32_t getHeight() const { return m_header->height; }
+	uint32_t getLevelCount() const { return m_header->levelCount; }
+	uint64_t getUploadSize() const { return m_header->uploadSize; }
+	const TextureFileLevel& getLevel(uint32_t level) const { return m_levels[level]; }
+	const uint8_t* getData() const { return m_mapping + m_header->dataOffset; }
+	const uint8_t* getLevelData(uint32_t level) const { return getData() + m_levels[level].offset; }
+	bool decodeLevel(uint32_t level, uint8_t* dst) const;
+};
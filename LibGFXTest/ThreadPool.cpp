@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+void ThreadPool::create(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// The thread calling parallelFor works too, so one worker less
+	m_stop = false;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void ThreadPool::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+{
+	if (count == 0) {
+		return;
+	}
+	if (m_workers.empty() || count == 1) {
+		for (uint32_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(m_submitMutex);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_completed = 0;
+		m_next = 0;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	uint32_t completed = runTasks();
+
+	// Wait until every index ran and no worker still looks at this task
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_completed += completed;
+	m_finished.wait(lock, [this] { return m_completed == m_count && m_active == 0; });
+	m_task = nullptr;
+}
+
+void ThreadPool::parallelForCallback(void* pool, int count, void (*task)(void* taskData, int index), void* taskData)
+{
+	static_cast<ThreadPool*>(pool)->parallelFor(static_cast<uint32_t>(count), [&](uint32_t i) {
+		task(taskData, static_cast<int>(i));
+	});
+}
+
+uint32_t ThreadPool::runTasks()
+{
+	uint32_t completed = 0;
+	for (uint32_t i = m_next++; i < m_count; i = m_next++) {
+		(*m_task)(i);
+		completed++;
+	}
+	return completed;
+}
+
+void ThreadPool::workerLoop()
+{
+	uint64_t generation = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [&] { return m_stop || (m_task && m_generation != generation); });
+		if (m_stop) {
+			return;
+		}
+		generation = m_generation;
+		m_active++;
+		lock.unlock();
+
+		uint32_t completed = runTasks();
+
+		lock.lock();
+		m_active--;
+		m_completed += completed;
+		if (m_completed == m_count && m_active == 0) {
+			m_finished.notify_one();
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+// Persistent worker threads for data parallel CPU work (image decoding, mip
+// generation). parallelFor hands out indices to the workers and the calling
+// thread and returns once every index ran. One parallelFor runs at a time.
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::mutex m_submitMutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_finished;
+	const std::function<void(uint32_t)>* m_task = nullptr;
+	std::atomic<uint32_t> m_next{ 0 };
+	uint32_t m_count = 0;
+	uint32_t m_completed = 0;
+	uint32_t m_active = 0;
+	uint64_t m_generation = 0;
+	bool m_stop = false;
+
+	void workerLoop();
+	uint32_t runTasks();
+
+public:
+	void create(uint32_t threadCount = 0);
+	void destroy();
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+	// C style entry point for libraries taking a parallel-for callback (stbi_set_parallel_for)
+	static void parallelForCallback(void* pool, int count, void (*task)(void* taskData, int index), void* taskData);
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+};
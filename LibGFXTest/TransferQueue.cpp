@@ -0,0 +1,451 @@
+#include "TransferQueue.h"
+#include "MipGenerator.h"
+#include "stb_image.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+// One copy region per level, all recorded in a single copy command
+static std::vector<VkBufferImageCopy> createCopyRegions(const std::vector<MipLevel>& levels)
+{
+	std::vector<VkBufferImageCopy> regions(levels.size());
+	for (uint32_t i = 0; i < levels.size(); i++) {
+		regions[i] = {};
+		regions[i].bufferOffset = levels[i].offset;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.baseArrayLayer = 0;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageExtent = { levels[i].width, levels[i].height, 1 };
+	}
+	return regions;
+}
+
+std::optional<uint32_t> TransferQueue::findTransferFamily(LibGFX::VkContext& context)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(context.getPhysicalDevice(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(context.getPhysicalDevice(), &familyCount, families.data());
+
+	// A family with transfer but without graphics or compute is the DMA engine
+	for (uint32_t i = 0; i < familyCount; i++) {
+		VkQueueFlags flags = families[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT)) {
+			return i;
+		}
+	}
+	return std::nullopt;
+}
+
+void TransferQueue::create(LibGFX::VkContext& context, const DeviceFeatures& features, VkDeviceSize stagingSize)
+{
+	VkDevice device = context.getDevice();
+	if (!features.timelineSemaphore) {
+		throw std::runtime_error("transfer queue needs timeline semaphores enabled on the device!");
+	}
+
+	// Only a family the device was created with a queue of can be used, otherwise uploads share the graphics queue
+	auto queueFamilyIndices = context.getQueueFamilyIndices(context.getPhysicalDevice());
+	m_graphicsFamily = queueFamilyIndices.graphicsFamily;
+	m_transferFamily = features.transferFamily != VK_QUEUE_FAMILY_IGNORED ? features.transferFamily : m_graphicsFamily;
+	vkGetDeviceQueue(device, m_transferFamily, 0, &m_queue);
+
+	// Transient command pool on the transfer family
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transfer command pool!");
+	}
+
+	// Timeline semaphore, every upload signals the next value
+	VkSemaphoreTypeCreateInfo typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_timeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transfer timeline semaphore!");
+	}
+
+	// Staging ring, mapped once for the lifetime of the queue
+	m_stagingBuffer = context.createBuffer(
+		stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	void* mapped = nullptr;
+	if (vkMapMemory(device, m_stagingBuffer.memory, 0, m_stagingBuffer.size, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map staging ring buffer!");
+	}
+	m_stagingMapped = static_cast<uint8_t*>(mapped);
+	m_stagingHead = 0;
+
+	m_submittedValue = 0;
+	m_acquiredValue = 0;
+}
+
+void TransferQueue::destroy(LibGFX::VkContext& context)
+{
+	VkDevice device = context.getDevice();
+
+	// Wait for outstanding uploads before freeing their staging memory
+	if (m_submittedValue > 0) {
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timeline;
+		waitInfo.pValues = &m_submittedValue;
+		vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+	}
+	collect(context);
+
+	vkUnmapMemory(device, m_stagingBuffer.memory);
+	context.destroyBuffer(m_stagingBuffer);
+	m_stagingMapped = nullptr;
+
+	vkDestroySemaphore(device, m_timeline, nullptr);
+	vkDestroyCommandPool(device, m_commandPool, nullptr);
+	m_pendingAcquires.clear();
+}
+
+Texture TransferQueue::uploadTexture(LibGFX::VkContext& context, const LibGFX::ImageData& imageData, bool generateMipmaps)
+{
+	uint32_t mipLevels = generateMipmaps ? calculateMipLevels(imageData.width, imageData.height) : 1;
+	auto levels = calculateMipChain(imageData.width, imageData.height, 4, mipLevels);
+
+	Texture texture = createTexture(context, imageData.width, imageData.height, mipLevels, imageData.format,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	// Build the whole mip chain in staging memory which stays reserved until the upload completed
+	auto staging = allocateStaging(context, levels.back().offset + levels.back().size);
+	generateMipChainRGBA8(static_cast<const uint8_t*>(imageData.pixels), levels, staging.mapped);
+
+	submitImageCopy(context, texture, staging, createCopyRegions(levels));
+	return texture;
+}
+
+Texture TransferQueue::uploadTexture(LibGFX::VkContext& context, const std::string& imagePath, bool generateMipmaps)
+{
+	// Only the header is read here, the size decides the staging layout
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	if (!stbi_info(imagePath.c_str(), &width, &height, &channels)) {
+		throw std::runtime_error("failed to load texture image!");
+	}
+
+	uint32_t mipLevels = generateMipmaps ? calculateMipLevels(width, height) : 1;
+	auto levels = calculateMipChain(width, height, 4, mipLevels);
+
+	// The decoder writes level 0 rows straight into the mapped staging memory,
+	// no decoded copy of the image exists in host memory
+	auto staging = allocateStaging(context, levels.back().offset + levels.back().size);
+	uint8_t* level0 = staging.mapped + levels[0].offset;
+	if (!stbi_load_into(imagePath.c_str(), level0, width * 4, height, &width, &height, &channels, STBI_rgb_alpha)) {
+		releaseStaging(context, staging);
+		throw std::runtime_error("failed to load texture image!");
+	}
+	generateMipChainRGBA8(level0, levels, staging.mapped);
+
+	Texture texture = createTexture(context, levels[0].width, levels[0].height, mipLevels, VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	submitImageCopy(context, texture, staging, createCopyRegions(levels));
+	return texture;
+}
+
+Texture TransferQueue::uploadTexture(LibGFX::VkContext& context, const MappedTextureFile& textureFile, uint32_t baseLevel)
+{
+	// Pre-baked (usually block compressed) levels are copied as they are
+	VkFormat format = getVkFormat(textureFile.getFormat());
+	if (!isSampledFormatSupported(context, format)) {
+		throw std::runtime_error("texture format is not supported by the device!");
+	}
+	if (baseLevel >= textureFile.getLevelCount()) {
+		throw std::runtime_error("texture base level is out of range!");
+	}
+
+	// Level baseLevel of the file becomes level 0 of the image
+	uint32_t mipLevels = textureFile.getLevelCount() - baseLevel;
+	uint32_t width = std::max(1u, textureFile.getWidth() >> baseLevel);
+	uint32_t height = std::max(1u, textureFile.getHeight() >> baseLevel);
+	Texture texture = createTexture(context, width, height, mipLevels, format,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	// Levels are stored smallest first, the uploaded ones are one range of the upload layout
+	uint64_t uploadBegin = textureFile.getUploadSize();
+	uint64_t uploadEnd = 0;
+	for (uint32_t i = baseLevel; i < textureFile.getLevelCount(); i++) {
+		const TextureFileLevel& level = textureFile.getLevel(i);
+		uploadBegin = std::min(uploadBegin, level.uploadOffset);
+		uploadEnd = std::max(uploadEnd, level.uploadOffset + level.uploadSize);
+	}
+
+	// The file is laid out in upload order, plain files are one copy from the mapping
+	auto staging = allocateStaging(context, uploadEnd - uploadBegin);
+	if (textureFile.getSupercompression() == Supercompression::None) {
+		std::memcpy(staging.mapped, textureFile.getData() + uploadBegin, uploadEnd - uploadBegin);
+	}
+	else {
+		for (uint32_t i = baseLevel; i < textureFile.getLevelCount(); i++) {
+			if (!textureFile.decodeLevel(i, staging.mapped + textureFile.getLevel(i).uploadOffset - uploadBegin)) {
+				releaseStaging(context, staging);
+				destroyTexture(context, texture);
+				throw std::runtime_error("failed to decode supercompressed texture level!");
+			}
+		}
+	}
+
+	// Extents are in texels, the copy rounds partial blocks up itself
+	std::vector<VkBufferImageCopy> regions(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		regions[i] = {};
+		regions[i].bufferOffset = textureFile.getLevel(baseLevel + i).uploadOffset - uploadBegin;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.baseArrayLayer = 0;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageExtent = { std::max(1u, width >> i), std::max(1u, height >> i), 1 };
+	}
+
+	submitImageCopy(context, texture, staging, regions);
+	return texture;
+}
+
+TransferQueue::StagingAllocation TransferQueue::allocateStaging(LibGFX::VkContext& context, VkDeviceSize size)
+{
+	// Offsets stay aligned for any texel block size and optimal copy alignment
+	const VkDeviceSize alignment = 256;
+	const VkDeviceSize capacity = m_stagingBuffer.size;
+
+	const PendingUpload* oldest = nullptr;
+	for (const auto& pending : m_inFlight) {
+		if (!pending.staging.dedicated) {
+			oldest = &pending;
+			break;
+		}
+	}
+
+	StagingAllocation allocation;
+	allocation.size = size;
+	bool fits = false;
+	if (!oldest) {
+		// Ring is empty, start over at the beginning
+		allocation.offset = 0;
+		fits = size <= capacity;
+	}
+	else {
+		VkDeviceSize head = (m_stagingHead + alignment - 1) & ~(alignment - 1);
+		VkDeviceSize tail = oldest->staging.offset;
+		if (head > tail) {
+			// Free space at the end, or wrap around in front of the oldest upload
+			if (head + size <= capacity) {
+				allocation.offset = head;
+				fits = true;
+			}
+			else if (size <= tail) {
+				allocation.offset = 0;
+				fits = true;
+			}
+		}
+		else if (head + size <= tail) {
+			allocation.offset = head;
+			fits = true;
+		}
+	}
+
+	if (fits) {
+		allocation.buffer = m_stagingBuffer.buffer;
+		allocation.mapped = m_stagingMapped + allocation.offset;
+		m_stagingHead = allocation.offset + size;
+		return allocation;
+	}
+
+	// Too large or the ring is full, use a staging buffer of its own
+	allocation.dedicated = true;
+	allocation.offset = 0;
+	allocation.dedicatedBuffer = context.createBuffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	allocation.buffer = allocation.dedicatedBuffer.buffer;
+
+	void* mapped = nullptr;
+	if (vkMapMemory(context.getDevice(), allocation.dedicatedBuffer.memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map texture staging buffer!");
+	}
+	allocation.mapped = static_cast<uint8_t*>(mapped);
+	return allocation;
+}
+
+void TransferQueue::releaseStaging(LibGFX::VkContext& context, StagingAllocation& staging)
+{
+	// Ring space is reclaimed by the next allocation, only dedicated buffers need freeing
+	if (staging.dedicated) {
+		vkUnmapMemory(context.getDevice(), staging.dedicatedBuffer.memory);
+		context.destroyBuffer(staging.dedicatedBuffer);
+	}
+	else if (m_stagingHead == staging.offset + staging.size) {
+		m_stagingHead = staging.offset;
+	}
+	staging = StagingAllocation();
+}
+
+void TransferQueue::submitImageCopy(LibGFX::VkContext& context, const Texture& texture, const StagingAllocation& staging, std::vector<VkBufferImageCopy> regions)
+{
+	VkDevice device = context.getDevice();
+
+	// Region offsets are relative to the allocation
+	for (auto& region : regions) {
+		region.bufferOffset += staging.offset;
+	}
+	if (staging.dedicated) {
+		vkUnmapMemory(device, staging.dedicatedBuffer.memory);
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate transfer command buffer!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	VkImageSubresourceRange range = {};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = texture.mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	// Undefined -> transfer destination
+	VkImageMemoryBarrier toTransfer = {};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = texture.image;
+	toTransfer.subresourceRange = range;
+	toTransfer.srcAccessMask = 0;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	// Transfer destination -> shader read. On a dedicated family this is the
+	// release half of the ownership transfer, the graphics queue acquires it.
+	VkImageMemoryBarrier release = {};
+	release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	release.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	release.srcQueueFamilyIndex = isDedicated() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	release.dstQueueFamilyIndex = isDedicated() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+	release.image = texture.image;
+	release.subresourceRange = range;
+	release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	release.dstAccessMask = isDedicated() ? 0 : VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		isDedicated() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &release);
+
+	vkEndCommandBuffer(commandBuffer);
+
+	// Submit and signal the next timeline value
+	uint64_t signalValue = m_submittedValue + 1;
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_timeline;
+
+	if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit transfer command buffer!");
+	}
+	m_submittedValue = signalValue;
+
+	m_inFlight.push_back({ signalValue, commandBuffer, staging });
+	if (isDedicated()) {
+		m_pendingAcquires.push_back({ texture.image, texture.mipLevels });
+	}
+}
+
+uint64_t TransferQueue::recordAcquireBarriers(VkCommandBuffer commandBuffer)
+{
+	// Nothing new since the last frame, no need to wait on the transfer queue
+	if (m_acquiredValue == m_submittedValue) {
+		return 0;
+	}
+
+	// Acquire half of the ownership transfers, executed after the semaphore wait
+	std::vector<VkImageMemoryBarrier> barriers;
+	barriers.reserve(m_pendingAcquires.size());
+	for (const auto& pending : m_pendingAcquires) {
+		VkImageMemoryBarrier acquire = {};
+		acquire.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		acquire.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		acquire.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		acquire.srcQueueFamilyIndex = m_transferFamily;
+		acquire.dstQueueFamilyIndex = m_graphicsFamily;
+		acquire.image = pending.image;
+		acquire.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		acquire.subresourceRange.baseMipLevel = 0;
+		acquire.subresourceRange.levelCount = pending.mipLevels;
+		acquire.subresourceRange.baseArrayLayer = 0;
+		acquire.subresourceRange.layerCount = 1;
+		acquire.srcAccessMask = 0;
+		acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers.push_back(acquire);
+	}
+
+	if (!barriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+	m_pendingAcquires.clear();
+
+	// The frame has to wait for this value at the fragment shader stage
+	m_acquiredValue = m_submittedValue;
+	return m_acquiredValue;
+}
+
+void TransferQueue::collect(LibGFX::VkContext& context)
+{
+	VkDevice device = context.getDevice();
+
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(device, m_timeline, &completedValue);
+
+	// Uploads complete in submission order, release command buffers and staging memory
+	while (!m_inFlight.empty() && m_inFlight.front().value <= completedValue) {
+		PendingUpload& upload = m_inFlight.front();
+		vkFreeCommandBuffers(device, m_commandPool, 1, &upload.commandBuffer);
+		if (upload.staging.dedicated) {
+			context.destroyBuffer(upload.staging.dedicatedBuffer);
+		}
+		m_inFlight.pop_front();
+	}
+}
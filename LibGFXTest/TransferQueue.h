@@ -0,0 +1,80 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <string>
+#include <cstdint>
+#include "VkContext.h"
+#include "Imaging.h"
+#include "Texture.h"
+#include "TextureFile.h"
+#include "DeviceFeatures.h"
+
+// Records texture uploads on a dedicated transfer queue family so streaming
+// does not occupy the graphics queue. Completion is signaled on a timeline
+// semaphore, ownership moves to the graphics family with release/acquire
+// barriers. Falls back to the graphics family when the device was created
+// without a queue of a separate transfer family, then uploads share the
+// graphics queue and no ownership transfer is recorded. LibGFX's context
+// currently creates no such queue, so this is the path LibGFXTest runs.
+// Staging memory comes from a persistently mapped ring buffer, uploads that do
+// not fit into it get a dedicated staging buffer.
+class TransferQueue
+{
+private:
+	struct StagingAllocation
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+		bool dedicated = false;
+		LibGFX::Buffer dedicatedBuffer;
+	};
+
+	struct PendingUpload
+	{
+		uint64_t value;
+		VkCommandBuffer commandBuffer;
+		StagingAllocation staging;
+	};
+
+	struct PendingAcquire
+	{
+		VkImage image;
+		uint32_t mipLevels;
+	};
+
+	VkQueue m_queue = VK_NULL_HANDLE;
+	uint32_t m_transferFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	VkSemaphore m_timeline = VK_NULL_HANDLE;
+	uint64_t m_submittedValue = 0;
+	uint64_t m_acquiredValue = 0;
+	LibGFX::Buffer m_stagingBuffer;
+	uint8_t* m_stagingMapped = nullptr;
+	VkDeviceSize m_stagingHead = 0;
+	std::deque<PendingUpload> m_inFlight;
+	std::vector<PendingAcquire> m_pendingAcquires;
+
+	StagingAllocation allocateStaging(LibGFX::VkContext& context, VkDeviceSize size);
+	void releaseStaging(LibGFX::VkContext& context, StagingAllocation& staging);
+	void submitImageCopy(LibGFX::VkContext& context, const Texture& texture, const StagingAllocation& staging, std::vector<VkBufferImageCopy> regions);
+
+public:
+	// Transfer-only family to request a queue of when creating the device
+	static std::optional<uint32_t> findTransferFamily(LibGFX::VkContext& context);
+	// Needs timeline semaphores, uploads go to features.transferFamily when it is set
+	void create(LibGFX::VkContext& context, const DeviceFeatures& features, VkDeviceSize stagingSize = 64ull * 1024 * 1024);
+	void destroy(LibGFX::VkContext& context);
+	Texture uploadTexture(LibGFX::VkContext& context, const LibGFX::ImageData& imageData, bool generateMipmaps = true);
+	Texture uploadTexture(LibGFX::VkContext& context, const std::string& imagePath, bool generateMipmaps = true);
+	Texture uploadTexture(LibGFX::VkContext& context, const MappedTextureFile& textureFile, uint32_t baseLevel = 0);
+	uint64_t recordAcquireBarriers(VkCommandBuffer commandBuffer);
+	void collect(LibGFX::VkContext& context);
+	bool isDedicated() const { return m_transferFamily != m_graphicsFamily; }
+	VkSemaphore getSemaphore() const { return m_timeline; }
+	uint64_t getSubmittedValue() const { return m_submittedValue; }
+};
@@ -433,6 +433,17 @@ extern "C" {
     STBIDEF stbi_uc* stbi_load_gif_from_memory(stbi_uc const* buffer, int len, int** delays, int* x, int* y, int* z, int* comp, int req_comp);
 #endif
 
+    // decode into caller owned memory (e.g. a mapped staging buffer) instead of
+    // a malloc'd result. rows are out_stride bytes apart, out_rows rows are
+    // available. desired_channels must be 1..4, query the size with stbi_info.
+    // JPEG and 8-bit non-interlaced PNG write their rows directly, other
+    // formats decode as usual and are copied. returns 1 on success, 0 on failure
+    STBIDEF int      stbi_load_from_memory_into(stbi_uc const* buffer, int len, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* channels_in_file, int desired_channels);
+    STBIDEF int      stbi_load_from_callbacks_into(stbi_io_callbacks const* clbk, void* user, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* channels_in_file, int desired_channels);
+#ifndef STBI_NO_STDIO
+    STBIDEF int      stbi_load_into(char const* filename, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* channels_in_file, int desired_channels);
+#endif
+
 #ifdef STBI_WINDOWS_UTF8
     STBIDEF int stbi_convert_wchar_to_utf8(char* buffer, size_t bufferlen, const wchar_t* input);
 #endif
@@ -524,6 +535,13 @@ extern "C" {
     STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
     STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+    // let the decoders spread work of large images over a worker pool. func has to
+    // call task(task_data, i) for every i in [0, count), in any order and on any
+    // thread, and return once all of them finished. worker_count is the number of
+    // threads func runs tasks on, used to size the work split. pass NULL to disable
+    typedef void stbi_parallel_for_func(void* user, int count, void (*task)(void* task_data, int index), void* task_data);
+    STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func* func, void* user, int worker_count);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int initial_size, int* outlen);
@@ -750,7 +768,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     int info3 = stbi__cpuid3();
@@ -761,7 +779,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     // If we're even attempting to compile this on GCC/Clang, that means
@@ -774,6 +792,74 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
+// widest kernel set the decoders may pick: -1 = scalar, 0 = SSE2, 1 = AVX2, 2 = AVX-512BW.
+// Not part of the API, benchmarks lower it to time the narrower paths.
+static int stbi__simd_limit = 2;
+#endif
+
+// AVX2 / AVX-512BW JPEG kernels. These are compiled with per-function target
+// attributes and only selected after a runtime CPUID check, so the rest of the
+// file keeps assuming nothing beyond SSE2. #define STBI_NO_AVX2 or
+// STBI_NO_AVX512 to leave them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG)
+#if defined(_MSC_VER) && !defined(__clang__) && _MSC_VER >= 1900
+#define STBI_AVX2
+#if _MSC_VER >= 1911 && !defined(STBI_NO_AVX512)
+#define STBI_AVX512
+#endif
+#elif !defined(_MSC_VER) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 6))
+#define STBI_AVX2
+#if !defined(STBI_NO_AVX512)
+#define STBI_AVX512
+#endif
+#endif
+#endif
+
+#ifdef STBI_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define STBI__TARGET_AVX2
+#define STBI__TARGET_AVX512
+#else
+#define STBI__TARGET_AVX2 __attribute__((target("avx2")))
+#define STBI__TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#endif
+
+// 0 = SSE2 only, 1 = AVX2, 2 = AVX-512BW (both also need OS support for the wider state)
+static int stbi__avx_level(void)
+{
+#ifdef _MSC_VER
+    int info[4], level = 0;
+    unsigned __int64 xcr0;
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    if ((info[2] & (3 << 27)) != (3 << 27)) return 0; // OSXSAVE + AVX
+    xcr0 = _xgetbv(0);
+    if ((xcr0 & 6) != 6) return 0; // XMM + YMM state
+    __cpuidex(info, 7, 0);
+    if (info[1] & (1 << 5)) {
+        level = 1;
+#ifdef STBI_AVX512
+        // AVX512F + AVX512BW, opmask + ZMM state
+        if ((info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xe6) == 0xe6)
+            level = 2;
+#endif
+    }
+    return level;
+#else
+    // these check for OS support of the register state as well
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2")) return 0;
+#ifdef STBI_AVX512
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return 2;
+#endif
+    return 1;
+#endif
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -817,6 +903,10 @@ typedef struct
 
     stbi_uc* img_buffer, * img_buffer_end;
     stbi_uc* img_buffer_original, * img_buffer_original_end;
+
+    // optional caller supplied output (stbi_load_into), NULL for malloc'd results
+    stbi_uc* out_target;
+    int out_stride, out_rows, out_flip;
 } stbi__context;
 
 
@@ -828,6 +918,7 @@ static void stbi__start_mem(stbi__context* s, stbi_uc const* buffer, int len)
     s->io.read = NULL;
     s->read_from_callbacks = 0;
     s->callback_already_read = 0;
+    s->out_target = NULL;
     s->img_buffer = s->img_buffer_original = (stbi_uc*)buffer;
     s->img_buffer_end = s->img_buffer_original_end = (stbi_uc*)buffer + len;
 }
@@ -840,6 +931,7 @@ static void stbi__start_callbacks(stbi__context* s, stbi_io_callbacks* c, void*
     s->buflen = sizeof(s->buffer_start);
     s->read_from_callbacks = 1;
     s->callback_already_read = 0;
+    s->out_target = NULL;
     s->img_buffer = s->img_buffer_original = s->buffer_start;
     stbi__refill_buffer(s);
     s->img_buffer_original_end = s->img_buffer_end;
@@ -1113,6 +1205,34 @@ static stbi_uc* stbi__hdr_to_ldr(float* data, int x, int y, int comp);
 
 static int stbi__vertically_flip_on_load_global = 0;
 
+#ifndef STBI_PARALLEL_MIN_PIXELS
+#define STBI_PARALLEL_MIN_PIXELS (1 << 20) // smaller images aren't worth the task overhead
+#endif
+
+static stbi_parallel_for_func* stbi__parallel_for_func = NULL;
+static void* stbi__parallel_for_user = NULL;
+static int stbi__parallel_workers = 1;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func* func, void* user, int worker_count)
+{
+    stbi__parallel_for_func = func;
+    stbi__parallel_for_user = user;
+    stbi__parallel_workers = worker_count > 0 ? worker_count : 1;
+}
+
+#ifndef STBI_NO_JPEG
+// true if work for an image of this size should go to the worker pool
+static int stbi__use_parallel(stbi__uint32 x, stbi__uint32 y)
+{
+    return stbi__parallel_for_func != NULL && stbi__parallel_workers > 1 && (double)x * y >= STBI_PARALLEL_MIN_PIXELS;
+}
+
+static void stbi__parallel_for(int count, void (*task)(void* task_data, int index), void* task_data)
+{
+    stbi__parallel_for_func(stbi__parallel_for_user, count, task, task_data);
+}
+#endif
+
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
     stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
@@ -1134,6 +1254,23 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+// check that an image of the current size with n channels fits the caller's output
+static int stbi__target_fits(stbi__context* s, int n)
+{
+    if (s->out_stride < 0 || s->out_rows < 0) return 0;
+    return (stbi__uint32)s->out_stride / (stbi__uint32)n >= s->img_x && (stbi__uint32)s->out_rows >= s->img_y;
+}
+
+// row j of the caller's output, vertical flipping is done by the row mapping.
+// the flag is captured up front, rows may be written from worker threads
+static stbi_uc* stbi__target_row(stbi__context* s, stbi__uint32 j)
+{
+    if (s->out_flip) j = s->img_y - 1 - j;
+    return s->out_target + (size_t)s->out_stride * j;
+}
+#endif
+
 static void* stbi__load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1283,6 +1420,43 @@ static unsigned char* stbi__load_and_postprocess_8bit(stbi__context* s, int* x,
     return (unsigned char*)result;
 }
 
+static int stbi__load_into(stbi__context* s, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* comp, int req_comp)
+{
+    stbi__result_info ri;
+    void* result;
+    int j, row_bytes;
+
+    if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+    s->out_target = out;
+    s->out_stride = out_stride;
+    s->out_rows = out_rows;
+    s->out_flip = stbi__vertically_flip_on_load;
+
+    result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+    s->out_target = NULL;
+    if (result == NULL)
+        return 0;
+    if (result == out)
+        return 1; // decoder wrote straight into the target
+
+    // decoders without a direct path: convert like stbi_load and copy the rows over
+    if (ri.bits_per_channel != 8) {
+        result = stbi__convert_16_to_8((stbi__uint16*)result, *x, *y, req_comp);
+        if (result == NULL) return 0;
+    }
+    if ((stbi__uint32)out_stride / (stbi__uint32)req_comp < (stbi__uint32)*x || out_rows < *y) {
+        STBI_FREE(result);
+        return stbi__err("too large", "Image larger than output");
+    }
+    row_bytes = *x * req_comp;
+    for (j = 0; j < *y; ++j) {
+        int dst_row = stbi__vertically_flip_on_load ? *y - 1 - j : j;
+        memcpy(out + (size_t)out_stride * dst_row, (stbi_uc*)result + (size_t)row_bytes * j, row_bytes);
+    }
+    STBI_FREE(result);
+    return 1;
+}
+
 static stbi__uint16* stbi__load_and_postprocess_16bit(stbi__context* s, int* x, int* y, int* comp, int req_comp)
 {
     stbi__result_info ri;
@@ -1373,6 +1547,18 @@ STBIDEF stbi_uc* stbi_load(char const* filename, int* x, int* y, int* comp, int
     return result;
 }
 
+STBIDEF int stbi_load_into(char const* filename, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* comp, int req_comp)
+{
+    FILE* f = stbi__fopen(filename, "rb");
+    int result;
+    stbi__context s;
+    if (!f) return stbi__err("can't fopen", "Unable to open file");
+    stbi__start_file(&s, f);
+    result = stbi__load_into(&s, out, out_stride, out_rows, x, y, comp, req_comp);
+    fclose(f);
+    return result;
+}
+
 STBIDEF stbi_uc* stbi_load_from_file(FILE* f, int* x, int* y, int* comp, int req_comp)
 {
     unsigned char* result;
@@ -1440,6 +1626,20 @@ STBIDEF stbi_uc* stbi_load_from_callbacks(stbi_io_callbacks const* clbk, void* u
     return stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
 }
 
+STBIDEF int stbi_load_from_memory_into(stbi_uc const* buffer, int len, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* comp, int req_comp)
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    return stbi__load_into(&s, out, out_stride, out_rows, x, y, comp, req_comp);
+}
+
+STBIDEF int stbi_load_from_callbacks_into(stbi_io_callbacks const* clbk, void* user, stbi_uc* out, int out_stride, int out_rows, int* x, int* y, int* comp, int req_comp)
+{
+    stbi__context s;
+    stbi__start_callbacks(&s, (stbi_io_callbacks*)clbk, user);
+    return stbi__load_into(&s, out, out_stride, out_rows, x, y, comp, req_comp);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc* stbi_load_gif_from_memory(stbi_uc const* buffer, int len, int** delays, int* x, int* y, int* z, int* comp, int req_comp)
 {
@@ -1973,7 +2173,6 @@ typedef struct
         int x, y, w2, h2;
         stbi_uc* data;
         void* raw_data, * raw_coeff;
-        stbi_uc* linebuf;
         short* coeff;   // progressive only
         int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
     } img_comp[4];
@@ -1998,6 +2197,7 @@ typedef struct
 
     // kernels
     void (*idct_block_kernel)(stbi_uc* out, int out_stride, short data[64]);
+    void (*idct_blocks_kernel)(stbi_uc* out, int out_stride, short* data, int count); // optional, see stbi__jpeg_idct_blocks
     void (*YCbCr_to_RGB_kernel)(stbi_uc* out, const stbi_uc* y, const stbi_uc* pcb, const stbi_uc* pcr, int count, int step);
     stbi_uc* (*resample_row_hv_2_kernel)(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs);
 } stbi__jpeg;
@@ -2717,137 +2917,542 @@ static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
-#ifdef STBI_NEON
+#ifdef STBI_AVX2
 
-// NEON integer IDCT. should produce bit-identical
-// results to the generic C version.
-static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
+STBI__TARGET_AVX2 static void stbi__idct_avx2_x2(stbi_uc* out, int out_stride, short* data)
 {
-    int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
-
-    int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
-    int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
-    int16x4_t rot0_2 = vdup_n_s16(stbi__f2f(0.765366865f));
-    int16x4_t rot1_0 = vdup_n_s16(stbi__f2f(1.175875602f));
-    int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
-    int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
-    int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
-    int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
-    int16x4_t rot3_0 = vdup_n_s16(stbi__f2f(0.298631336f));
-    int16x4_t rot3_1 = vdup_n_s16(stbi__f2f(2.053119869f));
-    int16x4_t rot3_2 = vdup_n_s16(stbi__f2f(3.072711026f));
-    int16x4_t rot3_3 = vdup_n_s16(stbi__f2f(1.501321110f));
+    // the SSE2 IDCT only ever works within 128-bit lanes, so the same sequence
+    // on 256-bit registers transforms 2 side by side blocks with identical results.
+    __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m256i tmp;
 
-#define dct_long_mul(out, inq, coeff) \
-   int32x4_t out##_l = vmull_s16(vget_low_s16(inq), coeff); \
-   int32x4_t out##_h = vmull_s16(vget_high_s16(inq), coeff)
+    // dot product constant: even elems=x, odd elems=y
+#define dct_const(x,y)  _mm256_broadcastsi128_si256(_mm_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y)))
 
-#define dct_long_mac(out, acc, inq, coeff) \
-   int32x4_t out##_l = vmlal_s16(acc##_l, vget_low_s16(inq), coeff); \
-   int32x4_t out##_h = vmlal_s16(acc##_h, vget_high_s16(inq), coeff)
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+// out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
 
-#define dct_widen(out, inq) \
-   int32x4_t out##_l = vshll_n_s16(vget_low_s16(inq), 12); \
-   int32x4_t out##_h = vshll_n_s16(vget_high_s16(inq), 12)
+   // out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
 
-    // wide add
+   // wide add
 #define dct_wadd(out, a, b) \
-   int32x4_t out##_l = vaddq_s32(a##_l, b##_l); \
-   int32x4_t out##_h = vaddq_s32(a##_h, b##_h)
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
 
-// wide sub
+   // wide sub
 #define dct_wsub(out, a, b) \
-   int32x4_t out##_l = vsubq_s32(a##_l, b##_l); \
-   int32x4_t out##_h = vsubq_s32(a##_h, b##_h)
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
 
-// butterfly a/b, then shift using "shiftop" by "s" and pack
-#define dct_bfly32o(out0,out1, a,b,shiftop,s) \
-   { \
-      dct_wadd(sum, a, b); \
-      dct_wsub(dif, a, b); \
-      out0 = vcombine_s16(shiftop(sum_l, s), shiftop(sum_h, s)); \
-      out1 = vcombine_s16(shiftop(dif_l, s), shiftop(dif_h, s)); \
-   }
+   // butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
 
-#define dct_pass(shiftop, shift) \
-   { \
-      /* even part */ \
-      int16x8_t sum26 = vaddq_s16(row2, row6); \
-      dct_long_mul(p1e, sum26, rot0_0); \
-      dct_long_mac(t2e, p1e, row6, rot0_1); \
-      dct_long_mac(t3e, p1e, row2, rot0_2); \
-      int16x8_t sum04 = vaddq_s16(row0, row4); \
-      int16x8_t dif04 = vsubq_s16(row0, row4); \
-      dct_widen(t0e, sum04); \
-      dct_widen(t1e, dif04); \
-      dct_wadd(x0, t0e, t3e); \
-      dct_wsub(x3, t0e, t3e); \
-      dct_wadd(x1, t1e, t2e); \
-      dct_wsub(x2, t1e, t2e); \
-      /* odd part */ \
-      int16x8_t sum15 = vaddq_s16(row1, row5); \
-      int16x8_t sum17 = vaddq_s16(row1, row7); \
-      int16x8_t sum35 = vaddq_s16(row3, row5); \
-      int16x8_t sum37 = vaddq_s16(row3, row7); \
-      int16x8_t sumodd = vaddq_s16(sum17, sum35); \
-      dct_long_mul(p5o, sumodd, rot1_0); \
-      dct_long_mac(p1o, p5o, sum17, rot1_1); \
-      dct_long_mac(p2o, p5o, sum35, rot1_2); \
-      dct_long_mul(p3o, sum37, rot2_0); \
-      dct_long_mul(p4o, sum15, rot2_1); \
-      dct_wadd(sump13o, p1o, p3o); \
-      dct_wadd(sump24o, p2o, p4o); \
-      dct_wadd(sump23o, p2o, p3o); \
-      dct_wadd(sump14o, p1o, p4o); \
-      dct_long_mac(x4, sump13o, row7, rot3_0); \
-      dct_long_mac(x5, sump24o, row5, rot3_1); \
-      dct_long_mac(x6, sump23o, row3, rot3_2); \
-      dct_long_mac(x7, sump14o, row1, rot3_3); \
-      dct_bfly32o(row0,row7, x0,x7,shiftop,shift); \
-      dct_bfly32o(row1,row6, x1,x6,shiftop,shift); \
-      dct_bfly32o(row2,row5, x2,x5,shiftop,shift); \
-      dct_bfly32o(row3,row4, x3,x4,shiftop,shift); \
-   }
+   // 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
 
-   // load
-    row0 = vld1q_s16(data + 0 * 8);
-    row1 = vld1q_s16(data + 1 * 8);
-    row2 = vld1q_s16(data + 2 * 8);
-    row3 = vld1q_s16(data + 3 * 8);
-    row4 = vld1q_s16(data + 4 * 8);
-    row5 = vld1q_s16(data + 5 * 8);
-    row6 = vld1q_s16(data + 6 * 8);
-    row7 = vld1q_s16(data + 7 * 8);
+   // 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
 
-    // add DC bias
-    row0 = vaddq_s16(row0, vsetq_lane_s16(1024, vdupq_n_s16(0), 0));
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    // load, block 0 in the low lane and block 1 in the high lane
+#define dct_load(r) _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i*) (data + r * 8))), _mm_load_si128((const __m128i*) (data + 64 + r * 8)), 1)
+    row0 = dct_load(0);
+    row1 = dct_load(1);
+    row2 = dct_load(2);
+    row3 = dct_load(3);
+    row4 = dct_load(4);
+    row5 = dct_load(5);
+    row6 = dct_load(6);
+    row7 = dct_load(7);
+#undef dct_load
 
     // column pass
-    dct_pass(vrshrn_n_s32, 10);
+    dct_pass(bias_0, 10);
 
-    // 16bit 8x8 transpose
     {
-        // these three map to a single VTRN.16, VTRN.32, and VSWP, respectively.
-        // whether compilers actually get this is another story, sadly.
-#define dct_trn16(x, y) { int16x8x2_t t = vtrnq_s16(x, y); x = t.val[0]; y = t.val[1]; }
-#define dct_trn32(x, y) { int32x4x2_t t = vtrnq_s32(vreinterpretq_s32_s16(x), vreinterpretq_s32_s16(y)); x = vreinterpretq_s16_s32(t.val[0]); y = vreinterpretq_s16_s32(t.val[1]); }
-#define dct_trn64(x, y) { int16x8_t x0 = x; int16x8_t y0 = y; x = vcombine_s16(vget_low_s16(x0), vget_low_s16(y0)); y = vcombine_s16(vget_high_s16(x0), vget_high_s16(y0)); }
+        // 16bit 8x8 transpose pass 1
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
 
-      // pass 1
-        dct_trn16(row0, row1); // a0b0a2b2a4b4a6b6
-        dct_trn16(row2, row3);
-        dct_trn16(row4, row5);
-        dct_trn16(row6, row7);
+        // transpose pass 2
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
 
-        // pass 2
-        dct_trn32(row0, row2); // a0b0c0d0a4b4c4d4
-        dct_trn32(row1, row3);
-        dct_trn32(row4, row6);
-        dct_trn32(row5, row7);
+        // transpose pass 3
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
 
-        // pass 3
-        dct_trn64(row0, row4); // a0b0c0d0e0f0g0h0
-        dct_trn64(row1, row5);
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack
+        __m256i p0 = _mm256_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+        __m256i p1 = _mm256_packus_epi16(row2, row3);
+        __m256i p2 = _mm256_packus_epi16(row4, row5);
+        __m256i p3 = _mm256_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose pass 1
+        dct_interleave8(p0, p2); // a0e0a1e1...
+        dct_interleave8(p1, p3); // c0g0c1g1...
+
+        // transpose pass 2
+        dct_interleave8(p0, p1); // a0c0e0g0...
+        dct_interleave8(p2, p3); // b0d0f0h0...
+
+        // transpose pass 3
+        dct_interleave8(p0, p2); // a0b0c0d0...
+        dct_interleave8(p1, p3); // a4b4c4d4...
+
+        // store, one lane per block
+#define dct_store(v) \
+        _mm_storel_epi64((__m128i*) out, _mm256_castsi256_si128(v)); \
+        _mm_storel_epi64((__m128i*) (out + 8), _mm256_extracti128_si256(v, 1)); \
+        out += out_stride
+        dct_store(p0);
+        dct_store(_mm256_shuffle_epi32(p0, 0x4e));
+        dct_store(p2);
+        dct_store(_mm256_shuffle_epi32(p2, 0x4e));
+        dct_store(p1);
+        dct_store(_mm256_shuffle_epi32(p1, 0x4e));
+        dct_store(p3);
+        dct_store(_mm256_shuffle_epi32(p3, 0x4e));
+#undef dct_store
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+// idct count horizontally adjacent blocks whose coefficients are stored back to back
+STBI__TARGET_AVX2 static void stbi__idct_blocks_avx2(stbi_uc* out, int out_stride, short* data, int count)
+{
+    for (; count >= 2; count -= 2, out += 16, data += 128)
+        stbi__idct_avx2_x2(out, out_stride, data);
+    if (count) {
+        // the SSE2 code is not VEX encoded, clear the upper halves first to avoid the transition stall
+        _mm256_zeroupper();
+        stbi__idct_simd(out, out_stride, data);
+    }
+}
+
+#ifdef STBI_AVX512
+// GCC 12 reports the undefined pass-through operand inside the unmasked AVX-512
+// intrinsics as -Wmaybe-uninitialized, the values never reach a result
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+STBI__TARGET_AVX512 static void stbi__idct_avx512_x4(stbi_uc* out, int out_stride, short* data)
+{
+    // the SSE2 IDCT only ever works within 128-bit lanes, so the same sequence
+    // on 512-bit registers transforms 4 side by side blocks with identical results.
+    __m512i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m512i tmp;
+
+    // dot product constant: even elems=x, odd elems=y
+#define dct_const(x,y)  _mm512_broadcast_i32x4(_mm_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y)))
+
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+// out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m512i c0##lo = _mm512_unpacklo_epi16((x),(y)); \
+      __m512i c0##hi = _mm512_unpackhi_epi16((x),(y)); \
+      __m512i out0##_l = _mm512_madd_epi16(c0##lo, c0); \
+      __m512i out0##_h = _mm512_madd_epi16(c0##hi, c0); \
+      __m512i out1##_l = _mm512_madd_epi16(c0##lo, c1); \
+      __m512i out1##_h = _mm512_madd_epi16(c0##hi, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m512i out##_l = _mm512_srai_epi32(_mm512_unpacklo_epi16(_mm512_setzero_si512(), (in)), 4); \
+      __m512i out##_h = _mm512_srai_epi32(_mm512_unpackhi_epi16(_mm512_setzero_si512(), (in)), 4)
+
+   // wide add
+#define dct_wadd(out, a, b) \
+      __m512i out##_l = _mm512_add_epi32(a##_l, b##_l); \
+      __m512i out##_h = _mm512_add_epi32(a##_h, b##_h)
+
+   // wide sub
+#define dct_wsub(out, a, b) \
+      __m512i out##_l = _mm512_sub_epi32(a##_l, b##_l); \
+      __m512i out##_h = _mm512_sub_epi32(a##_h, b##_h)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m512i abiased_l = _mm512_add_epi32(a##_l, bias); \
+         __m512i abiased_h = _mm512_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm512_packs_epi32(_mm512_srai_epi32(sum_l, s), _mm512_srai_epi32(sum_h, s)); \
+         out1 = _mm512_packs_epi32(_mm512_srai_epi32(dif_l, s), _mm512_srai_epi32(dif_h, s)); \
+      }
+
+   // 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm512_unpacklo_epi8(a, b); \
+      b = _mm512_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm512_unpacklo_epi16(a, b); \
+      b = _mm512_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m512i sum04 = _mm512_add_epi16(row0, row4); \
+         __m512i dif04 = _mm512_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m512i sum17 = _mm512_add_epi16(row1, row7); \
+         __m512i sum35 = _mm512_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    __m512i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m512i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m512i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m512i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m512i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m512i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m512i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m512i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m512i bias_0 = _mm512_set1_epi32(512);
+    __m512i bias_1 = _mm512_set1_epi32(65536 + (128 << 17));
+
+    // load, block k in 128-bit lane k
+#define dct_lane(b, r) _mm_load_si128((const __m128i*) (data + b * 64 + r * 8))
+#define dct_load(r) _mm512_inserti32x4(_mm512_inserti32x4(_mm512_inserti32x4(_mm512_castsi128_si512(dct_lane(0, r)), dct_lane(1, r), 1), dct_lane(2, r), 2), dct_lane(3, r), 3)
+    row0 = dct_load(0);
+    row1 = dct_load(1);
+    row2 = dct_load(2);
+    row3 = dct_load(3);
+    row4 = dct_load(4);
+    row5 = dct_load(5);
+    row6 = dct_load(6);
+    row7 = dct_load(7);
+#undef dct_load
+#undef dct_lane
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose pass 1
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        // transpose pass 2
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        // transpose pass 3
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack
+        __m512i p0 = _mm512_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+        __m512i p1 = _mm512_packus_epi16(row2, row3);
+        __m512i p2 = _mm512_packus_epi16(row4, row5);
+        __m512i p3 = _mm512_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose pass 1
+        dct_interleave8(p0, p2); // a0e0a1e1...
+        dct_interleave8(p1, p3); // c0g0c1g1...
+
+        // transpose pass 2
+        dct_interleave8(p0, p1); // a0c0e0g0...
+        dct_interleave8(p2, p3); // b0d0f0h0...
+
+        // transpose pass 3
+        dct_interleave8(p0, p2); // a0b0c0d0...
+        dct_interleave8(p1, p3); // a4b4c4d4...
+
+        // store, one lane per block
+#define dct_store(v) \
+        _mm_storel_epi64((__m128i*) out, _mm512_castsi512_si128(v)); \
+        _mm_storel_epi64((__m128i*) (out + 8), _mm512_extracti32x4_epi32(v, 1)); \
+        _mm_storel_epi64((__m128i*) (out + 16), _mm512_extracti32x4_epi32(v, 2)); \
+        _mm_storel_epi64((__m128i*) (out + 24), _mm512_extracti32x4_epi32(v, 3)); \
+        out += out_stride
+        dct_store(p0);
+        dct_store(_mm512_shuffle_epi32(p0, (_MM_PERM_ENUM) 0x4e));
+        dct_store(p2);
+        dct_store(_mm512_shuffle_epi32(p2, (_MM_PERM_ENUM) 0x4e));
+        dct_store(p1);
+        dct_store(_mm512_shuffle_epi32(p1, (_MM_PERM_ENUM) 0x4e));
+        dct_store(p3);
+        dct_store(_mm512_shuffle_epi32(p3, (_MM_PERM_ENUM) 0x4e));
+#undef dct_store
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+STBI__TARGET_AVX512 static void stbi__idct_blocks_avx512(stbi_uc* out, int out_stride, short* data, int count)
+{
+    for (; count >= 4; count -= 4, out += 32, data += 256)
+        stbi__idct_avx512_x4(out, out_stride, data);
+    stbi__idct_blocks_avx2(out, out_stride, data, count);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // STBI_AVX512
+#endif // STBI_AVX2
+
+#ifdef STBI_NEON
+
+// NEON integer IDCT. should produce bit-identical
+// results to the generic C version.
+static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
+{
+    int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
+
+    int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
+    int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
+    int16x4_t rot0_2 = vdup_n_s16(stbi__f2f(0.765366865f));
+    int16x4_t rot1_0 = vdup_n_s16(stbi__f2f(1.175875602f));
+    int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
+    int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
+    int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
+    int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
+    int16x4_t rot3_0 = vdup_n_s16(stbi__f2f(0.298631336f));
+    int16x4_t rot3_1 = vdup_n_s16(stbi__f2f(2.053119869f));
+    int16x4_t rot3_2 = vdup_n_s16(stbi__f2f(3.072711026f));
+    int16x4_t rot3_3 = vdup_n_s16(stbi__f2f(1.501321110f));
+
+#define dct_long_mul(out, inq, coeff) \
+   int32x4_t out##_l = vmull_s16(vget_low_s16(inq), coeff); \
+   int32x4_t out##_h = vmull_s16(vget_high_s16(inq), coeff)
+
+#define dct_long_mac(out, acc, inq, coeff) \
+   int32x4_t out##_l = vmlal_s16(acc##_l, vget_low_s16(inq), coeff); \
+   int32x4_t out##_h = vmlal_s16(acc##_h, vget_high_s16(inq), coeff)
+
+#define dct_widen(out, inq) \
+   int32x4_t out##_l = vshll_n_s16(vget_low_s16(inq), 12); \
+   int32x4_t out##_h = vshll_n_s16(vget_high_s16(inq), 12)
+
+    // wide add
+#define dct_wadd(out, a, b) \
+   int32x4_t out##_l = vaddq_s32(a##_l, b##_l); \
+   int32x4_t out##_h = vaddq_s32(a##_h, b##_h)
+
+// wide sub
+#define dct_wsub(out, a, b) \
+   int32x4_t out##_l = vsubq_s32(a##_l, b##_l); \
+   int32x4_t out##_h = vsubq_s32(a##_h, b##_h)
+
+// butterfly a/b, then shift using "shiftop" by "s" and pack
+#define dct_bfly32o(out0,out1, a,b,shiftop,s) \
+   { \
+      dct_wadd(sum, a, b); \
+      dct_wsub(dif, a, b); \
+      out0 = vcombine_s16(shiftop(sum_l, s), shiftop(sum_h, s)); \
+      out1 = vcombine_s16(shiftop(dif_l, s), shiftop(dif_h, s)); \
+   }
+
+#define dct_pass(shiftop, shift) \
+   { \
+      /* even part */ \
+      int16x8_t sum26 = vaddq_s16(row2, row6); \
+      dct_long_mul(p1e, sum26, rot0_0); \
+      dct_long_mac(t2e, p1e, row6, rot0_1); \
+      dct_long_mac(t3e, p1e, row2, rot0_2); \
+      int16x8_t sum04 = vaddq_s16(row0, row4); \
+      int16x8_t dif04 = vsubq_s16(row0, row4); \
+      dct_widen(t0e, sum04); \
+      dct_widen(t1e, dif04); \
+      dct_wadd(x0, t0e, t3e); \
+      dct_wsub(x3, t0e, t3e); \
+      dct_wadd(x1, t1e, t2e); \
+      dct_wsub(x2, t1e, t2e); \
+      /* odd part */ \
+      int16x8_t sum15 = vaddq_s16(row1, row5); \
+      int16x8_t sum17 = vaddq_s16(row1, row7); \
+      int16x8_t sum35 = vaddq_s16(row3, row5); \
+      int16x8_t sum37 = vaddq_s16(row3, row7); \
+      int16x8_t sumodd = vaddq_s16(sum17, sum35); \
+      dct_long_mul(p5o, sumodd, rot1_0); \
+      dct_long_mac(p1o, p5o, sum17, rot1_1); \
+      dct_long_mac(p2o, p5o, sum35, rot1_2); \
+      dct_long_mul(p3o, sum37, rot2_0); \
+      dct_long_mul(p4o, sum15, rot2_1); \
+      dct_wadd(sump13o, p1o, p3o); \
+      dct_wadd(sump24o, p2o, p4o); \
+      dct_wadd(sump23o, p2o, p3o); \
+      dct_wadd(sump14o, p1o, p4o); \
+      dct_long_mac(x4, sump13o, row7, rot3_0); \
+      dct_long_mac(x5, sump24o, row5, rot3_1); \
+      dct_long_mac(x6, sump23o, row3, rot3_2); \
+      dct_long_mac(x7, sump14o, row1, rot3_3); \
+      dct_bfly32o(row0,row7, x0,x7,shiftop,shift); \
+      dct_bfly32o(row1,row6, x1,x6,shiftop,shift); \
+      dct_bfly32o(row2,row5, x2,x5,shiftop,shift); \
+      dct_bfly32o(row3,row4, x3,x4,shiftop,shift); \
+   }
+
+   // load
+    row0 = vld1q_s16(data + 0 * 8);
+    row1 = vld1q_s16(data + 1 * 8);
+    row2 = vld1q_s16(data + 2 * 8);
+    row3 = vld1q_s16(data + 3 * 8);
+    row4 = vld1q_s16(data + 4 * 8);
+    row5 = vld1q_s16(data + 5 * 8);
+    row6 = vld1q_s16(data + 6 * 8);
+    row7 = vld1q_s16(data + 7 * 8);
+
+    // add DC bias
+    row0 = vaddq_s16(row0, vsetq_lane_s16(1024, vdupq_n_s16(0), 0));
+
+    // column pass
+    dct_pass(vrshrn_n_s32, 10);
+
+    // 16bit 8x8 transpose
+    {
+        // these three map to a single VTRN.16, VTRN.32, and VSWP, respectively.
+        // whether compilers actually get this is another story, sadly.
+#define dct_trn16(x, y) { int16x8x2_t t = vtrnq_s16(x, y); x = t.val[0]; y = t.val[1]; }
+#define dct_trn32(x, y) { int32x4x2_t t = vtrnq_s32(vreinterpretq_s32_s16(x), vreinterpretq_s32_s16(y)); x = vreinterpretq_s16_s32(t.val[0]); y = vreinterpretq_s16_s32(t.val[1]); }
+#define dct_trn64(x, y) { int16x8_t x0 = x; int16x8_t y0 = y; x = vcombine_s16(vget_low_s16(x0), vget_low_s16(y0)); y = vcombine_s16(vget_high_s16(x0), vget_high_s16(y0)); }
+
+      // pass 1
+        dct_trn16(row0, row1); // a0b0a2b2a4b4a6b6
+        dct_trn16(row2, row3);
+        dct_trn16(row4, row5);
+        dct_trn16(row6, row7);
+
+        // pass 2
+        dct_trn32(row0, row2); // a0b0c0d0a4b4c4d4
+        dct_trn32(row1, row3);
+        dct_trn32(row4, row6);
+        dct_trn32(row5, row7);
+
+        // pass 3
+        dct_trn64(row0, row4); // a0b0c0d0e0f0g0h0
+        dct_trn64(row1, row5);
         dct_trn64(row2, row6);
         dct_trn64(row3, row7);
 
@@ -2959,69 +3564,285 @@ static void stbi__jpeg_reset(stbi__jpeg* j)
     // since we don't even allow 1<<30 pixels
 }
 
-static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
+static int stbi__min(int a, int b) { return a < b ? a : b; }
+static int stbi__max(int a, int b) { return a > b ? a : b; }
+
+// MCU layout of the current scan. interleaved scans use the frame's MCUs, a single
+// component scan codes one block per MCU in plain block order
+static int stbi__jpeg_mcus_per_row(stbi__jpeg* z)
 {
-    stbi__jpeg_reset(z);
-    if (!z->progressive) {
-        if (z->scan_n == 1) {
-            int i, j;
-            STBI_SIMD_ALIGN(short, data[64]);
-            int n = z->order[0];
-            // non-interleaved data, we just need to process one block at a time,
-            // in trivial scanline order
-            // number of blocks to do just depends on how many actual "pixels" this
-            // component has, independent of interleaved MCU blocking and such
-            int w = (z->img_comp[n].x + 7) >> 3;
-            int h = (z->img_comp[n].y + 7) >> 3;
-            for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
-                    int ha = z->img_comp[n].ha;
-                    if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
-                    // every data block is an MCU, so countdown the restart interval
-                    if (--z->todo <= 0) {
-                        if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                        // if it's NOT a restart, then just bail, so we get corrupt data
-                        // rather than no data
-                        if (!STBI__RESTART(z->marker)) return 1;
-                        stbi__jpeg_reset(z);
-                    }
-                }
+    if (z->scan_n == 1) return (z->img_comp[z->order[0]].x + 7) >> 3;
+    return z->img_mcu_x;
+}
+
+static int stbi__jpeg_mcu_count(stbi__jpeg* z)
+{
+    if (z->scan_n == 1) return stbi__jpeg_mcus_per_row(z) * ((z->img_comp[z->order[0]].y + 7) >> 3);
+    return z->img_mcu_x * z->img_mcu_y;
+}
+
+static int stbi__jpeg_blocks_per_mcu(stbi__jpeg* z)
+{
+    int k, blocks = 0;
+    if (z->scan_n == 1) return 1;
+    for (k = 0; k < z->scan_n; ++k)
+        blocks += z->img_comp[z->order[k]].h * z->img_comp[z->order[k]].v;
+    return blocks;
+}
+
+// idct count horizontally adjacent blocks whose coefficients are stored back to
+// back, using the multi-block kernel when there is one
+static void stbi__jpeg_idct_blocks(stbi__jpeg* z, stbi_uc* out, int out_stride, short* data, int count)
+{
+    if (z->idct_blocks_kernel) {
+        z->idct_blocks_kernel(out, out_stride, data, count);
+        return;
+    }
+    for (; count > 0; --count, out += 8, data += 64)
+        z->idct_block_kernel(out, out_stride, data);
+}
+
+#define STBI__MCU_DECODE  1
+#define STBI__MCU_IDCT    2
+
+// entropy decode and/or inverse transform one MCU of a baseline scan. coeff keeps
+// the MCU's blocks between the two steps, with NULL both run on a local block
+static int stbi__jpeg_process_mcu(stbi__jpeg* z, int mcu, short* coeff, int ops)
+{
+    STBI_SIMD_ALIGN(short, data[4 * 64]);
+    int k, x, y, b = 0;
+    int mcus_per_row = stbi__jpeg_mcus_per_row(z);
+    int i = mcu % mcus_per_row;
+    int j = mcu / mcus_per_row;
+    for (k = 0; k < z->scan_n; ++k) {
+        int n = z->order[k];
+        // scan out an mcu's worth of this component; that's just determined
+        // by the basic H and V specified for the component
+        int h = z->scan_n == 1 ? 1 : z->img_comp[n].h;
+        int v = z->scan_n == 1 ? 1 : z->img_comp[n].v;
+        for (y = 0; y < v; ++y, b += h) {
+            // a row of the component's blocks is adjacent in the output, so the
+            // whole row goes through the idct in one call
+            short* blocks = coeff ? coeff + 64 * b : data;
+            if (ops & STBI__MCU_DECODE) {
+                int ha = z->img_comp[n].ha;
+                for (x = 0; x < h; ++x)
+                    if (!stbi__jpeg_decode_block(z, blocks + 64 * x, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+            }
+            if (ops & STBI__MCU_IDCT) {
+                int x2 = i * h * 8;
+                int y2 = (j * v + y) * 8;
+                stbi__jpeg_idct_blocks(z, z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, blocks, h);
             }
-            return 1;
         }
-        else { // interleaved
-            int i, j, k, x, y;
-            STBI_SIMD_ALIGN(short, data[64]);
-            for (j = 0; j < z->img_mcu_y; ++j) {
-                for (i = 0; i < z->img_mcu_x; ++i) {
-                    // scan an interleaved mcu... process scan_n components in order
-                    for (k = 0; k < z->scan_n; ++k) {
-                        int n = z->order[k];
-                        // scan out an mcu's worth of this component; that's just determined
-                        // by the basic H and V specified for the component
-                        for (y = 0; y < z->img_comp[n].v; ++y) {
-                            for (x = 0; x < z->img_comp[n].h; ++x) {
-                                int x2 = (i * z->img_comp[n].h + x) * 8;
-                                int y2 = (j * z->img_comp[n].v + y) * 8;
-                                int ha = z->img_comp[n].ha;
-                                if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                                z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
-                            }
-                        }
-                    }
-                    // after all interleaved components, that's an interleaved MCU,
-                    // so now count down the restart interval
-                    if (--z->todo <= 0) {
-                        if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                        if (!STBI__RESTART(z->marker)) return 1;
-                        stbi__jpeg_reset(z);
-                    }
-                }
+    }
+    return 1;
+}
+
+// decode count MCUs starting at first, counting down the restart interval after
+// each one. returns 0 on error, 2 if a missing restart marker ended the scan
+// early (we bail so we get corrupt data rather than no data), 1 otherwise
+static int stbi__jpeg_decode_mcu_range(stbi__jpeg* z, int first, int count, short* coeff, int ops, int* decoded)
+{
+    int m, blocks = stbi__jpeg_blocks_per_mcu(z);
+    if (decoded) *decoded = 0;
+    for (m = 0; m < count; ++m) {
+        if (!stbi__jpeg_process_mcu(z, first + m, coeff ? coeff + 64 * blocks * m : NULL, ops)) return 0;
+        if (decoded) *decoded = m + 1;
+        if (--z->todo <= 0) {
+            if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+            if (!STBI__RESTART(z->marker)) return 2;
+            stbi__jpeg_reset(z);
+        }
+    }
+    return 1;
+}
+
+// restart intervals are independent: buffer the scan, then decode and transform
+// groups of intervals on the worker pool, each with its own copy of the decoder
+typedef struct
+{
+    stbi__jpeg* z;
+    stbi_uc* data;
+    int* segment; // offset of each interval in data, plus the end
+    int segment_count, mcu_count, tasks;
+    int* result;
+} stbi__jpeg_restart_job;
+
+static void stbi__jpeg_restart_task(void* task_data, int index)
+{
+    stbi__jpeg_restart_job* job = (stbi__jpeg_restart_job*)task_data;
+    int first = job->segment_count * index / job->tasks;
+    int last = job->segment_count * (index + 1) / job->tasks;
+    int ri = job->z->restart_interval;
+    int k;
+    stbi__context s;
+    stbi__jpeg* local = (stbi__jpeg*)stbi__malloc(sizeof(stbi__jpeg));
+    job->result[index] = local != NULL;
+    if (!local) return;
+    memcpy(local, job->z, sizeof(stbi__jpeg));
+    local->s = &s;
+    for (k = first; k < last; ++k) {
+        int first_mcu = k * ri;
+        int count = stbi__min(ri, job->mcu_count - first_mcu);
+        stbi__start_mem(&s, job->data + job->segment[k], job->segment[k + 1] - job->segment[k]);
+        stbi__jpeg_reset(local);
+        if (!stbi__jpeg_decode_mcu_range(local, first_mcu, count, NULL, STBI__MCU_DECODE | STBI__MCU_IDCT, NULL)) {
+            job->result[index] = 0;
+            break;
+        }
+    }
+    STBI_FREE(local);
+}
+
+static int stbi__jpeg_decode_restart_parallel(stbi__jpeg* z, int mcu_count)
+{
+    stbi__context* s = z->s;
+    int expected = (mcu_count + z->restart_interval - 1) / z->restart_interval;
+    int cap = 1 << 16, len = 0, segment_count = 1, ok = 1, k;
+    unsigned char marker = STBI__MARKER_none;
+    stbi_uc* data = (stbi_uc*)stbi__malloc(cap);
+    int* segment = (int*)stbi__malloc_mad2(expected + 1, sizeof(int), 0);
+    if (!data || !segment) { STBI_FREE(data); STBI_FREE(segment); return stbi__err("outofmem", "Out of memory"); }
+
+    // read up to the marker that ends the scan, keeping stuffed bytes and restart
+    // markers in place so the intervals decode exactly like the serial path
+    segment[0] = 0;
+    while (!stbi__at_eof(s)) {
+        stbi_uc b = stbi__get8(s), c = 0;
+        if (b == 0xff) {
+            c = stbi__get8(s);
+            while (c == 0xff) c = stbi__get8(s); // consume fill bytes
+            if (c != 0 && !STBI__RESTART(c)) { marker = c; break; }
+        }
+        if (len + 2 > cap) {
+            stbi_uc* p = (stbi_uc*)STBI_REALLOC_SIZED(data, cap, cap * 2);
+            if (!p) { STBI_FREE(data); STBI_FREE(segment); return stbi__err("outofmem", "Out of memory"); }
+            data = p;
+            cap *= 2;
+        }
+        data[len++] = b;
+        if (b == 0xff) {
+            data[len++] = c;
+            if (c != 0) {
+                if (segment_count < expected) segment[segment_count] = len;
+                ++segment_count;
             }
-            return 1;
         }
     }
+
+    if (segment_count == expected) {
+        stbi__jpeg_restart_job job;
+        int result[256];
+        segment[segment_count] = len;
+        job.z = z;
+        job.data = data;
+        job.segment = segment;
+        job.segment_count = segment_count;
+        job.mcu_count = mcu_count;
+        job.tasks = stbi__min(segment_count, stbi__min(stbi__parallel_workers * 4, 256));
+        job.result = result;
+        stbi__parallel_for(job.tasks, stbi__jpeg_restart_task, &job);
+        for (k = 0; k < job.tasks; ++k)
+            ok &= result[k];
+    }
+    else {
+        // markers don't line up with the intervals, decode the buffer serially
+        stbi__context mem;
+        stbi__start_mem(&mem, data, len);
+        z->s = &mem;
+        stbi__jpeg_reset(z);
+        ok = stbi__jpeg_decode_mcu_range(z, 0, mcu_count, NULL, STBI__MCU_DECODE | STBI__MCU_IDCT, NULL) != 0;
+        z->s = s;
+    }
+    STBI_FREE(data);
+    STBI_FREE(segment);
+    z->marker = marker;
+    if (!ok) return stbi__err("bad huffman code", "Corrupt JPEG");
+    return 1;
+}
+
+// without restart markers the entropy decode is serial. decode bands of MCU rows
+// into coefficient buffers on one task while the other tasks transform the band
+// decoded before it
+typedef struct
+{
+    stbi__jpeg* z;
+    short* coeff[2];
+    int blocks;
+    int decode_first, decode_count, decode_band, decode_result, decoded;
+    int idct_first, idct_count, idct_band, idct_tasks;
+} stbi__jpeg_pipeline;
+
+static void stbi__jpeg_pipeline_task(void* task_data, int index)
+{
+    stbi__jpeg_pipeline* p = (stbi__jpeg_pipeline*)task_data;
+    if (index == 0) {
+        if (p->decode_count > 0)
+            p->decode_result = stbi__jpeg_decode_mcu_range(p->z, p->decode_first, p->decode_count, p->coeff[p->decode_band & 1], STBI__MCU_DECODE, &p->decoded);
+    }
+    else {
+        short* coeff = p->coeff[p->idct_band & 1];
+        int first = p->idct_count * (index - 1) / p->idct_tasks;
+        int last = p->idct_count * index / p->idct_tasks;
+        int m;
+        for (m = first; m < last; ++m)
+            stbi__jpeg_process_mcu(p->z, p->idct_first + m, coeff + 64 * p->blocks * m, STBI__MCU_IDCT);
+    }
+}
+
+static int stbi__jpeg_decode_pipelined(stbi__jpeg* z, int mcu_count)
+{
+    stbi__jpeg_pipeline p;
+    void* raw_coeff[2];
+    int ended = 0, band = 0, k;
+    int mcus_per_row = stbi__jpeg_mcus_per_row(z);
+    // whole MCU rows, enough of them to amortize a round on the pool
+    int band_mcus = stbi__max(1, 4096 / mcus_per_row) * mcus_per_row;
+
+    p.z = z;
+    p.blocks = stbi__jpeg_blocks_per_mcu(z);
+    for (k = 0; k < 2; ++k) {
+        raw_coeff[k] = stbi__malloc_mad3(band_mcus, p.blocks, 64 * sizeof(short), 15);
+        p.coeff[k] = (short*)(((size_t)raw_coeff[k] + 15) & ~15); // aligned for the simd idct
+    }
+    if (!raw_coeff[0] || !raw_coeff[1]) { STBI_FREE(raw_coeff[0]); STBI_FREE(raw_coeff[1]); return stbi__err("outofmem", "Out of memory"); }
+
+    p.idct_tasks = stbi__parallel_workers;
+    p.idct_first = p.idct_count = p.idct_band = 0;
+    p.decode_first = 0;
+    p.decode_result = 1;
+    while (p.idct_count > 0 || (!ended && p.decode_first < mcu_count)) {
+        p.decode_count = ended ? 0 : stbi__min(band_mcus, mcu_count - p.decode_first);
+        p.decode_band = band;
+        p.decoded = 0;
+        stbi__parallel_for(p.idct_count > 0 ? 1 + p.idct_tasks : 1, stbi__jpeg_pipeline_task, &p);
+        if (!p.decode_result) break;
+        if (p.decode_result == 2) ended = 1;
+
+        // the band just decoded is transformed in the next round
+        p.idct_first = p.decode_first;
+        p.idct_count = p.decoded;
+        p.idct_band = band++;
+        p.decode_first += p.decode_count;
+    }
+    STBI_FREE(raw_coeff[0]);
+    STBI_FREE(raw_coeff[1]);
+    return p.decode_result != 0;
+}
+
+static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
+{
+    stbi__jpeg_reset(z);
+    if (!z->progressive) {
+        int mcu_count = stbi__jpeg_mcu_count(z);
+        if (stbi__use_parallel(z->s->img_x, z->s->img_y)) {
+            if (z->restart_interval > 0 && mcu_count > z->restart_interval)
+                return stbi__jpeg_decode_restart_parallel(z, mcu_count);
+            return stbi__jpeg_decode_pipelined(z, mcu_count);
+        }
+        return stbi__jpeg_decode_mcu_range(z, 0, mcu_count, NULL, STBI__MCU_DECODE | STBI__MCU_IDCT, NULL) != 0;
+    }
     else {
         if (z->scan_n == 1) {
             int i, j;
@@ -3094,22 +3915,47 @@ static void stbi__jpeg_dequantize(short* data, stbi__uint16* dequant)
         data[i] *= dequant[i];
 }
 
+// dequantize and idct block rows [j0, j1) of component n
+static void stbi__jpeg_finish_rows(stbi__jpeg* z, int n, int j0, int j1)
+{
+    int i, j;
+    int w = (z->img_comp[n].x + 7) >> 3;
+    for (j = j0; j < j1; ++j) {
+        short* data = z->img_comp[n].coeff + 64 * j * z->img_comp[n].coeff_w;
+        for (i = 0; i < w; ++i)
+            stbi__jpeg_dequantize(data + 64 * i, z->dequant[z->img_comp[n].tq]);
+        stbi__jpeg_idct_blocks(z, z->img_comp[n].data + z->img_comp[n].w2 * j * 8, z->img_comp[n].w2, data, w);
+    }
+}
+
+typedef struct
+{
+    stbi__jpeg* z;
+    int bands;
+} stbi__jpeg_finish_job;
+
+static void stbi__jpeg_finish_task(void* task_data, int index)
+{
+    stbi__jpeg_finish_job* job = (stbi__jpeg_finish_job*)task_data;
+    int n = index / job->bands, band = index % job->bands;
+    int h = (job->z->img_comp[n].y + 7) >> 3;
+    stbi__jpeg_finish_rows(job->z, n, h * band / job->bands, h * (band + 1) / job->bands);
+}
+
 static void stbi__jpeg_finish(stbi__jpeg* z)
 {
     if (z->progressive) {
-        // dequantize and idct the data
-        int i, j, n;
-        for (n = 0; n < z->s->img_n; ++n) {
-            int w = (z->img_comp[n].x + 7) >> 3;
-            int h = (z->img_comp[n].y + 7) >> 3;
-            for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
-                    short* data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-                    stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
-                }
-            }
+        // dequantize and idct the data, blocks are independent so bands of rows can run in parallel
+        int n;
+        if (stbi__use_parallel(z->s->img_x, z->s->img_y)) {
+            stbi__jpeg_finish_job job;
+            job.z = z;
+            job.bands = stbi__parallel_workers * 2;
+            stbi__parallel_for(z->s->img_n * job.bands, stbi__jpeg_finish_task, &job);
+            return;
         }
+        for (n = 0; n < z->s->img_n; ++n)
+            stbi__jpeg_finish_rows(z, n, 0, (z->img_comp[n].y + 7) >> 3);
     }
 }
 
@@ -3273,10 +4119,6 @@ static int stbi__free_jpeg_components(stbi__jpeg* z, int ncomp, int why)
             z->img_comp[i].raw_coeff = 0;
             z->img_comp[i].coeff = 0;
         }
-        if (z->img_comp[i].linebuf) {
-            STBI_FREE(z->img_comp[i].linebuf);
-            z->img_comp[i].linebuf = NULL;
-        }
     }
     return why;
 }
@@ -3294,10 +4136,8 @@ static int stbi__process_frame_header(stbi__jpeg* z, int scan)
     c = stbi__get8(s);
     if (c != 3 && c != 1 && c != 4) return stbi__err("bad component count", "Corrupt JPEG");
     s->img_n = c;
-    for (i = 0; i < c; ++i) {
+    for (i = 0; i < c; ++i)
         z->img_comp[i].data = NULL;
-        z->img_comp[i].linebuf = NULL;
-    }
 
     if (Lf != 8 + 3 * s->img_n) return stbi__err("bad SOF len", "Corrupt JPEG");
 
@@ -3353,7 +4193,6 @@ static int stbi__process_frame_header(stbi__jpeg* z, int scan)
         z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
         z->img_comp[i].coeff = 0;
         z->img_comp[i].raw_coeff = 0;
-        z->img_comp[i].linebuf = NULL;
         z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
         if (z->img_comp[i].raw_data == NULL)
             return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
@@ -3549,17 +4388,12 @@ static stbi_uc* stbi__resample_row_hv_2(stbi_uc* out, stbi_uc* in_near, stbi_uc*
 }
 
 #if defined(STBI_SSE2) || defined(STBI_NEON)
-static stbi_uc* stbi__resample_row_hv_2_simd(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+// continue a 2x2 resample at input pixel i, t1 holds the vertically filtered
+// value of pixel i - 1 (or of pixel 0 when i == 0)
+static void stbi__resample_row_hv_2_simd_from(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int i, int t1)
 {
-    // need to generate 2x2 samples for every one in input
-    int i = 0, t0, t1;
-
-    if (w == 1) {
-        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
-        return out;
-    }
+    int t0;
 
-    t1 = 3 * in_near[0] + in_far[0];
     // process groups of 8 pixels for as long as we can.
     // note we can't handle the last pixel in a row in this loop
     // because we need to handle the filter boundary conditions.
@@ -3643,27 +4477,152 @@ static stbi_uc* stbi__resample_row_hv_2_simd(stbi_uc* out, stbi_uc* in_near, stb
         vst2_u8(out + i * 2, o);
 #endif
 
-        // "previous" value for next iter
-        t1 = 3 * in_near[i + 7] + in_far[i + 7];
+        // "previous" value for next iter
+        t1 = 3 * in_near[i + 7] + in_far[i + 7];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i) {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+}
+
+static stbi_uc* stbi__resample_row_hv_2_simd(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // need to generate 2x2 samples for every one in input
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    stbi__resample_row_hv_2_simd_from(out, in_near, in_far, w, 0, 3 * in_near[0] + in_far[0]);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+#endif
+
+#ifdef STBI_AVX2
+STBI__TARGET_AVX2 static stbi_uc* stbi__resample_row_hv_2_avx2(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time
+    int i = 0, t1;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
     }
 
-    t0 = t1;
-    t1 = 3 * in_near[i] + in_far[i];
-    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    t1 = 3 * in_near[0] + in_far[0];
+    for (; i < ((w - 1) & ~15); i += 16) {
+        // vertical pass, 3*x + y = 4*x + (y - x)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_near + i)));
+        __m256i diff = _mm256_sub_epi16(farw, nearw);
+        __m256i nears = _mm256_slli_epi16(nearw, 2);
+        __m256i curr = _mm256_add_epi16(nears, diff); // current row
+
+        // "prev"/"next" are the current row shifted by one pixel across the
+        // 128-bit lane boundary, with the neighbouring pixels inserted
+        __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+        __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+        __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+        __m256i next = _mm256_insert_epi16(nxt0, 3 * in_near[i + 16] + in_far[i + 16], 15);
+
+        // polyphase horizontal filter
+        __m256i bias = _mm256_set1_epi16(8);
+        __m256i curs = _mm256_slli_epi16(curr, 2);
+        __m256i prvd = _mm256_sub_epi16(prev, curr);
+        __m256i nxtd = _mm256_sub_epi16(next, curr);
+        __m256i curb = _mm256_add_epi16(curs, bias);
+        __m256i even = _mm256_add_epi16(prvd, curb);
+        __m256i odd = _mm256_add_epi16(nxtd, curb);
+
+        // interleave even and odd pixels, then undo scaling. within each lane
+        // this lines up so the packed result is already in output order
+        __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+        __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+        __m256i de0 = _mm256_srli_epi16(int0, 4);
+        __m256i de1 = _mm256_srli_epi16(int1, 4);
+        _mm256_storeu_si256((__m256i*) (out + i * 2), _mm256_packus_epi16(de0, de1));
+
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    _mm256_zeroupper(); // see stbi__idct_blocks_avx2
+    stbi__resample_row_hv_2_simd_from(out, in_near, in_far, w, i, t1);
 
-    for (++i; i < w; ++i) {
-        t0 = t1;
-        t1 = 3 * in_near[i] + in_far[i];
-        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
-        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+
+#ifdef STBI_AVX512
+STBI__TARGET_AVX512 static stbi_uc* stbi__resample_row_hv_2_avx512(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // same filter as stbi__resample_row_hv_2_simd, 32 pixels at a time
+    int i = 0, t1;
+    __m512i prev_idx, next_idx;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
     }
-    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    prev_idx = _mm512_set_epi16(30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15,
+                                14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 0);
+    next_idx = _mm512_set_epi16(31, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+
+    t1 = 3 * in_near[0] + in_far[0];
+    for (; i < ((w - 1) & ~31); i += 32) {
+        // vertical pass, 3*x + y = 4*x + (y - x)
+        __m512i farw = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*) (in_far + i)));
+        __m512i nearw = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*) (in_near + i)));
+        __m512i diff = _mm512_sub_epi16(farw, nearw);
+        __m512i nears = _mm512_slli_epi16(nearw, 2);
+        __m512i curr = _mm512_add_epi16(nears, diff); // current row
+
+        // shift by one pixel with a full-width permute, then insert the neighbours
+        __m512i prev = _mm512_mask_set1_epi16(_mm512_permutexvar_epi16(prev_idx, curr), 1, (short) t1);
+        __m512i next = _mm512_mask_set1_epi16(_mm512_permutexvar_epi16(next_idx, curr), 0x80000000u, (short) (3 * in_near[i + 32] + in_far[i + 32]));
+
+        // polyphase horizontal filter
+        __m512i bias = _mm512_set1_epi16(8);
+        __m512i curs = _mm512_slli_epi16(curr, 2);
+        __m512i prvd = _mm512_sub_epi16(prev, curr);
+        __m512i nxtd = _mm512_sub_epi16(next, curr);
+        __m512i curb = _mm512_add_epi16(curs, bias);
+        __m512i even = _mm512_add_epi16(prvd, curb);
+        __m512i odd = _mm512_add_epi16(nxtd, curb);
+
+        // interleave, undo scaling, pack; lanes come out in output order
+        __m512i int0 = _mm512_unpacklo_epi16(even, odd);
+        __m512i int1 = _mm512_unpackhi_epi16(even, odd);
+        __m512i de0 = _mm512_srli_epi16(int0, 4);
+        __m512i de1 = _mm512_srli_epi16(int1, 4);
+        _mm512_storeu_si512((void*) (out + i * 2), _mm512_packus_epi16(de0, de1));
+
+        t1 = 3 * in_near[i + 31] + in_far[i + 31];
+    }
+
+    _mm256_zeroupper(); // see stbi__idct_blocks_avx2
+    stbi__resample_row_hv_2_simd_from(out, in_near, in_far, w, i, t1);
 
     STBI_NOTUSED(hs);
 
     return out;
 }
-#endif
+#endif // STBI_AVX512
+#endif // STBI_AVX2
 
 static stbi_uc* stbi__resample_row_generic(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
 {
@@ -3839,21 +4798,191 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc* out, stbi_uc const* y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+STBI__TARGET_AVX2 static void stbi__YCbCr_to_RGB_avx2(stbi_uc* out, stbi_uc const* y, stbi_uc const* pcb, stbi_uc const* pcr, int count, int step)
+{
+    // same arithmetic as stbi__YCbCr_to_RGB_simd, 16 pixels at a time
+    int i = 0;
+
+    if (step == 4) {
+        __m256i signflip = _mm256_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi8((char)(unsigned char)128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+        for (; i + 15 < count; i += 16) {
+            // load 16 bytes and move pixels 8..15 into the low half of the
+            // upper lane, so the per-lane unpacks below see 8 pixels each
+#define stbi__ycc_load(p) _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((__m128i*) (p + i))), 0x10)
+            __m256i y_bytes = stbi__ycc_load(y);
+            __m256i cr_bytes = stbi__ycc_load(pcr);
+            __m256i cb_bytes = stbi__ycc_load(pcb);
+#undef stbi__ycc_load
+            __m256i cr_biased = _mm256_xor_si256(cr_bytes, signflip); // -128
+            __m256i cb_biased = _mm256_xor_si256(cb_bytes, signflip); // -128
+
+            // unpack to short (and left-shift cr, cb by 8)
+            __m256i yw = _mm256_unpacklo_epi8(y_bias, y_bytes);
+            __m256i crw = _mm256_unpacklo_epi8(_mm256_setzero_si256(), cr_biased);
+            __m256i cbw = _mm256_unpacklo_epi8(_mm256_setzero_si256(), cb_biased);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte, set up for transpose
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+            // transpose to interleave channels. o0 holds pixels 0..3 and 8..11,
+            // o1 pixels 4..7 and 12..15
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // store
+            _mm256_storeu_si256((__m256i*) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i*) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+        }
+    }
+
+    _mm256_zeroupper(); // see stbi__idct_blocks_avx2
+    stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+
+#ifdef STBI_AVX512
+// see stbi__idct_avx512_x4
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+STBI__TARGET_AVX512 static void stbi__YCbCr_to_RGB_avx512(stbi_uc* out, stbi_uc const* y, stbi_uc const* pcb, stbi_uc const* pcr, int count, int step)
+{
+    // same arithmetic as stbi__YCbCr_to_RGB_simd, 32 pixels at a time
+    int i = 0;
+
+    if (step == 4) {
+        __m512i signflip = _mm512_set1_epi8(-0x80);
+        __m512i cr_const0 = _mm512_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+        __m512i cr_const1 = _mm512_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+        __m512i cb_const0 = _mm512_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+        __m512i cb_const1 = _mm512_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+        __m512i y_bias = _mm512_set1_epi8((char)(unsigned char)128);
+        __m512i xw = _mm512_set1_epi16(255); // alpha channel
+        // spreads 8-pixel groups over the 128-bit lanes on load, and gathers
+        // the lane halves back into pixel order on store
+        __m512i spread = _mm512_set_epi64(7, 3, 6, 2, 5, 1, 4, 0);
+        __m512i gather0 = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+        __m512i gather1 = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+
+        for (; i + 31 < count; i += 32) {
+            // load
+#define stbi__ycc_load(p) _mm512_permutexvar_epi64(spread, _mm512_zextsi256_si512(_mm256_loadu_si256((__m256i*) (p + i))))
+            __m512i y_bytes = stbi__ycc_load(y);
+            __m512i cr_bytes = stbi__ycc_load(pcr);
+            __m512i cb_bytes = stbi__ycc_load(pcb);
+#undef stbi__ycc_load
+            __m512i cr_biased = _mm512_xor_si512(cr_bytes, signflip); // -128
+            __m512i cb_biased = _mm512_xor_si512(cb_bytes, signflip); // -128
+
+            // unpack to short (and left-shift cr, cb by 8)
+            __m512i yw = _mm512_unpacklo_epi8(y_bias, y_bytes);
+            __m512i crw = _mm512_unpacklo_epi8(_mm512_setzero_si512(), cr_biased);
+            __m512i cbw = _mm512_unpacklo_epi8(_mm512_setzero_si512(), cb_biased);
+
+            // color transform
+            __m512i yws = _mm512_srli_epi16(yw, 4);
+            __m512i cr0 = _mm512_mulhi_epi16(cr_const0, crw);
+            __m512i cb0 = _mm512_mulhi_epi16(cb_const0, cbw);
+            __m512i cb1 = _mm512_mulhi_epi16(cbw, cb_const1);
+            __m512i cr1 = _mm512_mulhi_epi16(crw, cr_const1);
+            __m512i rws = _mm512_add_epi16(cr0, yws);
+            __m512i gwt = _mm512_add_epi16(cb0, yws);
+            __m512i bws = _mm512_add_epi16(yws, cb1);
+            __m512i gws = _mm512_add_epi16(gwt, cr1);
+
+            // descale
+            __m512i rw = _mm512_srai_epi16(rws, 4);
+            __m512i bw = _mm512_srai_epi16(bws, 4);
+            __m512i gw = _mm512_srai_epi16(gws, 4);
+
+            // back to byte, set up for transpose
+            __m512i brb = _mm512_packus_epi16(rw, bw);
+            __m512i gxb = _mm512_packus_epi16(gw, xw);
+
+            // transpose to interleave channels
+            __m512i t0 = _mm512_unpacklo_epi8(brb, gxb);
+            __m512i t1 = _mm512_unpackhi_epi8(brb, gxb);
+            __m512i o0 = _mm512_unpacklo_epi16(t0, t1);
+            __m512i o1 = _mm512_unpackhi_epi16(t0, t1);
+
+            // store
+            _mm512_storeu_si512((void*) (out + 0), _mm512_permutex2var_epi64(o0, gather0, o1));
+            _mm512_storeu_si512((void*) (out + 64), _mm512_permutex2var_epi64(o0, gather1, o1));
+            out += 128;
+        }
+    }
+
+    stbi__YCbCr_to_RGB_avx2(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // STBI_AVX512
+#endif // STBI_AVX2
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg* j)
 {
     j->idct_block_kernel = stbi__idct_block;
+    j->idct_blocks_kernel = NULL;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
     j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
 #ifdef STBI_SSE2
-    if (stbi__sse2_available()) {
+    if (stbi__simd_limit >= 0 && stbi__sse2_available()) {
         j->idct_block_kernel = stbi__idct_simd;
         j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
         j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
     }
 #endif
 
+#ifdef STBI_AVX2
+    if (stbi__simd_limit >= 1 && stbi__sse2_available()) {
+        int level = stbi__avx_level();
+        if (level > stbi__simd_limit) level = stbi__simd_limit;
+        if (level >= 1) {
+            j->idct_blocks_kernel = stbi__idct_blocks_avx2;
+            j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+            j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+        }
+#ifdef STBI_AVX512
+        if (level >= 2) {
+            j->idct_blocks_kernel = stbi__idct_blocks_avx512;
+            j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx512;
+            j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx512;
+        }
+#endif
+    }
+#endif
+
 #ifdef STBI_NEON
     j->idct_block_kernel = stbi__idct_simd;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3884,6 +5013,171 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
     return (stbi_uc)((t + (t >> 8)) >> 8);
 }
 
+// step a component's resampler to the next output row
+static void stbi__resample_advance(stbi__jpeg* z, stbi__resample* r, int k)
+{
+    if (++r->ystep >= r->vs) {
+        r->ystep = 0;
+        r->line0 = r->line1;
+        if (++r->ypos < z->img_comp[k].y)
+            r->line1 += z->img_comp[k].w2;
+    }
+}
+
+// resample and color-convert output rows [j0, j1). start holds the resampler state
+// at row 0, each call works on its own copy and line buffers so bands of rows can
+// be converted in parallel
+static int stbi__jpeg_convert_rows(stbi__jpeg* z, const stbi__resample* start, stbi_uc* output, int n, int decode_n, int is_rgb, stbi__uint32 j0, stbi__uint32 j1)
+{
+    int k, ok = 1;
+    unsigned int i, j;
+    stbi__resample res_comp[4];
+    stbi_uc* linebuf[4] = { NULL, NULL, NULL, NULL };
+    stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
+    stbi_uc* rowbuf = NULL;
+
+    for (k = 0; k < decode_n; ++k) {
+        res_comp[k] = start[k];
+        for (j = 0; j < j0; ++j)
+            stbi__resample_advance(z, &res_comp[k], k);
+        // allocate line buffer big enough for upsampling off the edges
+        // with upsample factor of 4
+        linebuf[k] = (stbi_uc*)stbi__malloc(z->s->img_x + 3);
+        ok &= linebuf[k] != NULL;
+    }
+    // conversions to fewer than 4 channels may write one byte past the row, stage
+    // those rows for the caller's output and when a later band owns the next row
+    if (n < 4 && (z->s->out_target || j1 < z->s->img_y)) {
+        rowbuf = (stbi_uc*)stbi__malloc_mad2(n, z->s->img_x, 1);
+        ok &= rowbuf != NULL;
+    }
+
+    for (j = j0; ok && j < j1; ++j) {
+        stbi_uc* out = rowbuf ? rowbuf : z->s->out_target ? stbi__target_row(z->s, j) : output + n * z->s->img_x * j;
+        for (k = 0; k < decode_n; ++k) {
+            stbi__resample* r = &res_comp[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                y_bot ? r->line1 : r->line0,
+                y_bot ? r->line0 : r->line1,
+                r->w_lores, r->hs);
+            stbi__resample_advance(z, r, k);
+        }
+        if (n >= 3) {
+            stbi_uc* y = coutput[0];
+            if (z->s->img_n == 3) {
+                if (is_rgb) {
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else if (z->s->img_n == 4) {
+                if (z->app14_color_transform == 0) { // CMYK
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                        out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                        out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else if (z->app14_color_transform == 2) { // YCCK
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(255 - out[0], m);
+                        out[1] = stbi__blinn_8x8(255 - out[1], m);
+                        out[2] = stbi__blinn_8x8(255 - out[2], m);
+                        out += n;
+                    }
+                }
+                else { // YCbCr + alpha?  Ignore the fourth channel for now
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else {
+            if (is_rgb) {
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i)
+                        *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                else {
+                    for (i = 0; i < z->s->img_x; ++i, out += 2) {
+                        out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                        out[1] = 255;
+                    }
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+                for (i = 0; i < z->s->img_x; ++i) {
+                    stbi_uc m = coutput[3][i];
+                    stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+                    stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+                    stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+                    out[0] = stbi__compute_y(r, g, b);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else {
+                stbi_uc* y = coutput[0];
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+                else
+                    for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+            }
+        }
+        if (rowbuf)
+            memcpy(z->s->out_target ? stbi__target_row(z->s, j) : output + n * z->s->img_x * j, rowbuf, n * z->s->img_x);
+    }
+
+    for (k = 0; k < decode_n; ++k)
+        STBI_FREE(linebuf[k]);
+    STBI_FREE(rowbuf);
+    return ok;
+}
+
+typedef struct
+{
+    stbi__jpeg* z;
+    const stbi__resample* start;
+    stbi_uc* output;
+    int n, decode_n, is_rgb, bands;
+    int ok[256];
+} stbi__jpeg_convert_job;
+
+static void stbi__jpeg_convert_task(void* task_data, int index)
+{
+    stbi__jpeg_convert_job* job = (stbi__jpeg_convert_job*)task_data;
+    stbi__uint32 h = job->z->s->img_y;
+    stbi__uint32 rows = (h + job->bands - 1) / job->bands;
+    stbi__uint32 j0 = rows * index < h ? rows * index : h;
+    stbi__uint32 j1 = j0 + rows < h ? j0 + rows : h;
+    job->ok[index] = stbi__jpeg_convert_rows(job->z, job->start, job->output, job->n, job->decode_n, job->is_rgb, j0, j1);
+}
+
 static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp, int req_comp)
 {
     int n, decode_n, is_rgb;
@@ -3911,21 +5205,14 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
 
     // resample and color-convert
     {
-        int k;
-        unsigned int i, j;
+        int k, ok = 1;
         stbi_uc* output;
-        stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
 
         stbi__resample res_comp[4];
 
         for (k = 0; k < decode_n; ++k) {
             stbi__resample* r = &res_comp[k];
 
-            // allocate line buffer big enough for upsampling off the edges
-            // with upsample factor of 4
-            z->img_comp[k].linebuf = (stbi_uc*)stbi__malloc(z->s->img_x + 3);
-            if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
             r->hs = z->img_h_max / z->img_comp[k].h;
             r->vs = z->img_v_max / z->img_comp[k].v;
             r->ystep = r->vs >> 1;
@@ -3940,115 +5227,38 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
             else                               r->resample = stbi__resample_row_generic;
         }
 
-        // can't error after this so, this is safe
-        output = (stbi_uc*)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-        if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-        // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j) {
-            stbi_uc* out = output + n * z->s->img_x * j;
-            for (k = 0; k < decode_n; ++k) {
-                stbi__resample* r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                    y_bot ? r->line1 : r->line0,
-                    y_bot ? r->line0 : r->line1,
-                    r->w_lores, r->hs);
-                if (++r->ystep >= r->vs) {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
-            }
-            if (n >= 3) {
-                stbi_uc* y = coutput[0];
-                if (z->s->img_n == 3) {
-                    if (is_rgb) {
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else if (z->s->img_n == 4) {
-                    if (z->app14_color_transform == 0) { // CMYK
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                            out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                            out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else if (z->app14_color_transform == 2) { // YCCK
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(255 - out[0], m);
-                            out[1] = stbi__blinn_8x8(255 - out[1], m);
-                            out[2] = stbi__blinn_8x8(255 - out[2], m);
-                            out += n;
-                        }
-                    }
-                    else { // YCbCr + alpha?  Ignore the fourth channel for now
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
-            }
-            else {
-                if (is_rgb) {
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i)
-                            *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                    else {
-                        for (i = 0; i < z->s->img_x; ++i, out += 2) {
-                            out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                            out[1] = 255;
-                        }
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        stbi_uc m = coutput[3][i];
-                        stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                        stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                        stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                        out[0] = stbi__compute_y(r, g, b);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else {
-                    stbi_uc* y = coutput[0];
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-                    else
-                        for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-                }
-            }
+        if (z->s->out_target) {
+            // rows go straight into the caller's memory
+            if (!stbi__target_fits(z->s, n)) { stbi__cleanup_jpeg(z); return stbi__errpuc("too large", "Image larger than output"); }
+            output = z->s->out_target;
+        }
+        else {
+            output = (stbi_uc*)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+            if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+        }
+
+        // now go ahead and resample, rows only depend on the component planes
+        if (stbi__use_parallel(z->s->img_x, z->s->img_y)) {
+            stbi__jpeg_convert_job job;
+            job.z = z;
+            job.start = res_comp;
+            job.output = output;
+            job.n = n;
+            job.decode_n = decode_n;
+            job.is_rgb = is_rgb;
+            job.bands = stbi__min(stbi__min(stbi__parallel_workers * 4, 256), (int)z->s->img_y);
+            stbi__parallel_for(job.bands, stbi__jpeg_convert_task, &job);
+            for (k = 0; k < job.bands; ++k)
+                ok &= job.ok[k];
+        }
+        else {
+            ok = stbi__jpeg_convert_rows(z, res_comp, output, n, decode_n, is_rgb, 0, z->s->img_y);
         }
         stbi__cleanup_jpeg(z);
+        if (!ok) {
+            if (output != z->s->out_target) STBI_FREE(output);
+            return stbi__errpuc("outofmem", "Out of memory");
+        }
         *out_x = z->s->img_x;
         *out_y = z->s->img_y;
         if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
@@ -4122,6 +5332,8 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
+#define STBI__ZMULTI_BITS 11 // index bits of the two-literal table, see stbi__zbuild_multi
+#define STBI__ZMULTI_MASK ((1 << STBI__ZMULTI_BITS) - 1)
 
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
@@ -4218,6 +5430,7 @@ typedef struct
     int   z_expandable;
 
     stbi__zhuffman z_length, z_distance;
+    stbi__uint32 z_multi[1 << STBI__ZMULTI_BITS]; // literal/length lookup for stbi__zinflate_fast
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf* z)
@@ -4339,11 +5552,194 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
 
+// the literal/length table used by the fast loop resolves up to STBI__ZMULTI_BITS
+// bits at once. an entry holds the first symbol and its code length, and when
+// that symbol is a literal directly followed by another literal whose code also
+// fits in the index, the second literal too:
+//    bits 0..8 symbol, 9..12 code length, 13..20 second literal,
+//    21..25 combined code length, 26 second literal present
+// 0 means the code is longer than the index (or invalid) and takes the slow path
+#define STBI__ZMULTI_PAIR (1 << 26)
+
+static void stbi__zbuild_multi(stbi__zbuf* a)
+{
+    stbi__zhuffman* z = &a->z_length;
+    stbi__uint32* m = a->z_multi;
+    int i, j, s;
+    memset(a->z_multi, 0, sizeof(a->z_multi));
+
+    // single symbols, straight from the canonical code of stbi__zbuild_huffman
+    for (s = 1; s <= STBI__ZMULTI_BITS; ++s) {
+        int count = (z->maxcode[s] >> (16 - s)) - z->firstcode[s];
+        for (i = 0; i < count; ++i) {
+            stbi__uint32 e = (stbi__uint32)((s << 9) | z->value[z->firstsymbol[s] + i]);
+            for (j = stbi__bit_reverse(z->firstcode[s] + i, s); j < (1 << STBI__ZMULTI_BITS); j += 1 << s)
+                m[j] = e;
+        }
+    }
+
+    // pair up literals. the lookup of the second symbol only reads its low
+    // 13 bits, which pairing leaves alone, so this can run in place
+    for (j = 0; j < (1 << STBI__ZMULTI_BITS); ++j) {
+        stbi__uint32 e = m[j], e2;
+        int len = (e >> 9) & 15, len2;
+        if (!e || (e & 511) >= 256 || len >= STBI__ZMULTI_BITS) continue;
+        e2 = m[j >> len];
+        len2 = (e2 >> 9) & 15;
+        if (!e2 || (e2 & 511) >= 256 || len + len2 > STBI__ZMULTI_BITS) continue;
+        m[j] = e | ((e2 & 255) << 13) | ((stbi__uint32)(len + len2) << 21) | STBI__ZMULTI_PAIR;
+    }
+}
+
+// the fast loop runs while it can't run out of input or output within one
+// symbol: at most 10 bytes are read per iteration, and a match writes up to
+// 258 bytes plus the overshoot of the 16-byte copies
+#define STBI__ZFAST_IN   16
+#define STBI__ZFAST_OUT  (258 + 16)
+
+// 0 decodes every symbol through the checked loop. not part of the API,
+// benchmarks clear it to compare against the fast loop
+static int stbi__zfast = 1;
+
+// decodes symbols without per-symbol bounds checks, using a local bit buffer
+// and wide match copies. returns 0 on error, 2 at the end of the block and 1
+// when the caller has to continue with the checked loop
+static int stbi__zinflate_fast(stbi__zbuf* a, char** pzout)
+{
+    stbi_uc* in = a->zbuffer;
+    stbi_uc* in_end = a->zbuffer_end - STBI__ZFAST_IN;
+    stbi__uint32 bits = a->code_buffer;
+    int num_bits = a->num_bits, result = 1;
+    char* zout = *pzout;
+    char* zout_start = a->zout_start;
+    char* zout_end = a->zout_end - STBI__ZFAST_OUT;
+    const stbi__uint32* multi = a->z_multi;
+    const stbi__uint16* dist_fast = a->z_distance.fast;
+
+    // tops the bit buffer up to at least 24 bits with one 4-byte read. bits
+    // above num_bits may then already hold the following input, which the next
+    // refill ORs in again unchanged; they are cleared before leaving
+#define stbi__zfast_refill() do { \
+    bits |= (in[0] | (in[1] << 8) | (in[2] << 16) | ((stbi__uint32)in[3] << 24)) << num_bits; \
+    in += (31 - num_bits) >> 3; \
+    num_bits |= 24; \
+} while (0)
+#define stbi__zfast_slowpath(out, table) \
+    a->code_buffer = bits; a->num_bits = num_bits; \
+    out = stbi__zhuffman_decode_slowpath(a, table); \
+    bits = a->code_buffer; num_bits = a->num_bits
+
+    while (in <= in_end && zout <= zout_end) {
+        stbi__uint32 e;
+        int z, len, dist, n;
+        char* p;
+
+        stbi__zfast_refill();
+        e = multi[bits & STBI__ZMULTI_MASK];
+        if (e & STBI__ZMULTI_PAIR) {
+            n = (e >> 21) & 31;
+            bits >>= n;
+            num_bits -= n;
+            zout[0] = (char)(e & 255);
+            zout[1] = (char)((e >> 13) & 255);
+            zout += 2;
+            continue;
+        }
+        if (e) {
+            n = (e >> 9) & 15;
+            bits >>= n;
+            num_bits -= n;
+            z = e & 511;
+        }
+        else {
+            stbi__zfast_slowpath(z, &a->z_length);
+            if (z < 0) { result = stbi__err("bad huffman code", "Corrupt PNG"); break; }
+        }
+        if (z < 256) {
+            *zout++ = (char)z;
+            continue;
+        }
+        if (z == 256) {
+            result = 2;
+            break;
+        }
+        if (z >= 286) { result = stbi__err("bad huffman code", "Corrupt PNG"); break; } // per DEFLATE, length codes 286 and 287 must not appear in compressed data
+        z -= 257;
+        len = stbi__zlength_base[z];
+        n = stbi__zlength_extra[z];
+        if (n) {
+            len += bits & ((1 << n) - 1);
+            bits >>= n;
+            num_bits -= n;
+        }
+
+        stbi__zfast_refill();
+        z = dist_fast[bits & STBI__ZFAST_MASK];
+        if (z) {
+            n = z >> 9;
+            bits >>= n;
+            num_bits -= n;
+            z &= 511;
+        }
+        else {
+            stbi__zfast_slowpath(z, &a->z_distance);
+        }
+        if (z < 0 || z >= 30) { result = stbi__err("bad huffman code", "Corrupt PNG"); break; } // per DEFLATE, distance codes 30 and 31 must not appear in compressed data
+        dist = stbi__zdist_base[z];
+        n = stbi__zdist_extra[z];
+        if (n) {
+            if (num_bits < n) stbi__zfast_refill();
+            dist += bits & ((1 << n) - 1);
+            bits >>= n;
+            num_bits -= n;
+        }
+        if (zout - zout_start < dist) { result = stbi__err("bad dist", "Corrupt PNG"); break; }
+
+        // copy the match. chunks may run past len, the output margin covers that
+        p = zout - dist;
+        if (dist == 1) {
+            memset(zout, *p, len);
+            zout += len;
+        }
+        else if (dist >= 8) {
+            char* end = zout + len;
+            if (dist >= 16) {
+                do { memcpy(zout, p, 16); zout += 16; p += 16; } while (zout < end);
+            }
+            else {
+                do { memcpy(zout, p, 8); zout += 8; p += 8; } while (zout < end);
+            }
+            zout = end;
+        }
+        else {
+            do *zout++ = *p++; while (--len);
+        }
+    }
+
+#undef stbi__zfast_refill
+#undef stbi__zfast_slowpath
+
+    a->zbuffer = in;
+    a->code_buffer = bits & ((1u << num_bits) - 1);
+    a->num_bits = num_bits;
+    *pzout = zout;
+    return result;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf* a)
 {
     char* zout = a->zout;
     for (;;) {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z;
+        if (stbi__zfast && a->zbuffer_end - a->zbuffer >= STBI__ZFAST_IN && a->zout_end - zout >= STBI__ZFAST_OUT) {
+            int r = stbi__zinflate_fast(a, &zout);
+            if (r == 0) return 0;
+            if (r == 2) {
+                a->zout = zout;
+                return 1;
+            }
+        }
+        z = stbi__zhuffman_decode(a, &a->z_length);
         if (z < 256) {
             if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG"); // error in huffman codes
             if (zout >= a->zout_end) {
@@ -4542,6 +5938,7 @@ static int stbi__parse_zlib(stbi__zbuf* a, int parse_header)
             else {
                 if (!stbi__compute_huffman_codes(a)) return 0;
             }
+            stbi__zbuild_multi(a);
             if (!stbi__parse_huffman_block(a)) return 0;
         }
     } while (!final);
@@ -4676,6 +6073,7 @@ typedef struct
     stbi__context* s;
     stbi_uc* idata, * expanded, * out;
     int depth;
+    int direct; // unfilter straight into the caller's output (stbi_load_into)
 } stbi__png;
 
 
@@ -4711,6 +6109,94 @@ static int stbi__paeth(int a, int b, int c)
     return t1;
 }
 
+#ifdef STBI_SSE2
+// pixels moved in and out of the low lanes of an SSE2 register. n is 4 or 3,
+// a 3-byte pixel can go through the 4-byte path while the row continues after
+// it: the extra byte read belongs to the row, the extra byte written is
+// overwritten by the next pixel
+stbi_inline static __m128i stbi__png_load_px(const stbi_uc* p, int n)
+{
+    int v;
+    if (n == 4) memcpy(&v, p, 4);
+    else v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_px(stbi_uc* p, __m128i px, int n)
+{
+    int v = _mm_cvtsi128_si32(px);
+    if (n == 4) memcpy(p, &v, 4);
+    else { p[0] = (stbi_uc)v; p[1] = (stbi_uc)(v >> 8); p[2] = (stbi_uc)(v >> 16); }
+}
+
+// whole-row unfilters for 3 and 4 byte pixels. Sub/Avg/Paeth chain through the
+// previous pixel, so except for 4-byte Sub they step one pixel at a time with
+// all channels in one register. prior is NULL on the first row, where the
+// pixels above count as 0. results match the scalar loops exactly
+static void stbi__unfilter_sub_sse2(stbi_uc* cur, const stbi_uc* raw, int nk, int bpp)
+{
+    __m128i a = _mm_setzero_si128();
+    int k = 0;
+    if (bpp == 4) {
+        // 4 pixels at a time as a running sum over the register
+        for (; k + 16 <= nk; k += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*) (raw + k));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, a);
+            _mm_storeu_si128((__m128i*) (cur + k), x);
+            a = _mm_shuffle_epi32(x, 0xff);
+        }
+    }
+    for (; k < nk; k += bpp) {
+        int n = k + 4 <= nk ? 4 : bpp;
+        a = _mm_add_epi8(stbi__png_load_px(raw + k, n), a);
+        stbi__png_store_px(cur + k, a, n);
+    }
+}
+
+static void stbi__unfilter_avg_sse2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int nk, int bpp)
+{
+    __m128i a = _mm_setzero_si128(), b = a;
+    __m128i one = _mm_set1_epi8(1);
+    int k;
+    for (k = 0; k < nk; k += bpp) {
+        int n = k + 4 <= nk ? 4 : bpp;
+        // floor((a + b) / 2) from the rounding-up byte average
+        if (prior) b = stbi__png_load_px(prior + k, n);
+        a = _mm_add_epi8(stbi__png_load_px(raw + k, n),
+                         _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one)));
+        stbi__png_store_px(cur + k, a, n);
+    }
+}
+
+static void stbi__unfilter_paeth_sse2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int nk, int bpp)
+{
+    // same branch-free formulation as stbi__paeth, in 16-bit lanes so the
+    // threshold doesn't overflow
+    __m128i zero = _mm_setzero_si128();
+    __m128i low8 = _mm_set1_epi16(255);
+    __m128i a = zero, c = zero; // left, upper left
+    int k;
+    for (k = 0; k < nk; k += bpp) {
+        int n = k + 4 <= nk ? 4 : bpp;
+        __m128i b = _mm_unpacklo_epi8(stbi__png_load_px(prior + k, n), zero); // up
+        __m128i x = _mm_unpacklo_epi8(stbi__png_load_px(raw + k, n), zero);
+        // only thresh, lo and hi depend on the previous pixel
+        __m128i thresh = _mm_sub_epi16(_mm_sub_epi16(_mm_add_epi16(c, _mm_add_epi16(c, c)), b), a);
+        __m128i lo = _mm_min_epi16(a, b);
+        __m128i hi = _mm_max_epi16(a, b);
+        __m128i use_c = _mm_cmpgt_epi16(hi, thresh);
+        __m128i use_t0 = _mm_cmpgt_epi16(thresh, lo);
+        __m128i t0 = _mm_or_si128(_mm_andnot_si128(use_c, lo), _mm_and_si128(use_c, c));
+        __m128i t1 = _mm_or_si128(_mm_andnot_si128(use_t0, hi), _mm_and_si128(use_t0, t0));
+        a = _mm_and_si128(_mm_add_epi16(x, t1), low8);
+        stbi__png_store_px(cur + k, _mm_packus_epi16(a, a), n);
+        c = b;
+    }
+}
+#endif
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // adds an extra all-255 alpha channel
@@ -4752,10 +6238,18 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
     int output_bytes = out_n * bytes;
     int filter_bytes = img_n * bytes;
     int width = x;
+#ifdef STBI_SSE2
+    int simd_unfilter;
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
-    a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-    if (!a->out) return stbi__err("outofmem", "Out of memory");
+    if (a->direct) {
+        a->out = NULL;
+    }
+    else {
+        a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+        if (!a->out) return stbi__err("outofmem", "Out of memory");
+    }
 
     // note: error exits here don't need to clean up a->out individually,
     // stbi__do_png always does on error.
@@ -4778,12 +6272,15 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
         filter_bytes = 1;
         width = img_width_bytes;
     }
+#ifdef STBI_SSE2
+    simd_unfilter = (filter_bytes == 3 || filter_bytes == 4) && stbi__simd_limit >= 0 && stbi__sse2_available();
+#endif
 
     for (j = 0; j < y; ++j) {
         // cur/prior filter buffers alternate
         stbi_uc* cur = filter_buf + (j & 1) * img_width_bytes;
         stbi_uc* prior = filter_buf + (~j & 1) * img_width_bytes;
-        stbi_uc* dest = a->out + stride * j;
+        stbi_uc* dest = a->direct ? stbi__target_row(s, j) : a->out + stride * j;
         int nk = width * filter_bytes;
         int filter = *raw++;
 
@@ -4796,6 +6293,15 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
         // if first row, use special filter that doesn't sample previous row
         if (j == 0) filter = first_row_filter[filter];
 
+#ifdef STBI_SSE2
+        if (simd_unfilter && filter == STBI__F_sub)
+            stbi__unfilter_sub_sse2(cur, raw, nk, filter_bytes);
+        else if (simd_unfilter && (filter == STBI__F_avg || filter == STBI__F_avg_first))
+            stbi__unfilter_avg_sse2(cur, raw, filter == STBI__F_avg ? prior : NULL, nk, filter_bytes);
+        else if (simd_unfilter && filter == STBI__F_paeth)
+            stbi__unfilter_paeth_sse2(cur, raw, prior, nk, filter_bytes);
+        else
+#endif
         // perform actual filtering
         switch (filter) {
         case STBI__F_none:
@@ -5271,6 +6777,9 @@ static int stbi__parse_png_file(stbi__png* z, int scan, int req_comp)
                 s->img_out_n = s->img_n + 1;
             else
                 s->img_out_n = s->img_n;
+            // plain 8-bit images that need no later conversion skip the intermediate image
+            z->direct = s->out_target && !interlace && z->depth == 8 && !has_trans && !pal_img_n && !is_iphone && s->img_out_n == req_comp;
+            if (z->direct && !stbi__target_fits(s, req_comp)) return stbi__err("too large", "Image larger than output");
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
             if (has_trans) {
                 if (z->depth == 16) {
@@ -5333,7 +6842,7 @@ static void* stbi__do_png(stbi__png* p, int* x, int* y, int* n, int req_comp, st
             ri->bits_per_channel = 16;
         else
             return stbi__errpuc("bad bits_per_channel", "PNG not supported: unsupported color depth");
-        result = p->out;
+        result = p->direct ? p->s->out_target : p->out;
         p->out = NULL;
         if (req_comp && req_comp != p->s->img_out_n) {
             if (ri->bits_per_channel == 8)
@@ -5358,6 +6867,7 @@ static void* stbi__png_load(stbi__context* s, int* x, int* y, int* comp, int req
 {
     stbi__png p;
     p.s = s;
+    p.direct = 0;
     return stbi__do_png(&p, x, y, comp, req_comp, ri);
 }
 
@@ -7,7 +7,23 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(set = 1, binding = 0) uniform sampler2D textureSampler;
 
+// Variant switches, set per pipeline through specialization constants
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = true;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+
+const float ALPHA_CUTOFF = 0.5;
+
 void main() { 
-    vec4 texColor = texture(textureSampler, fragTexCoord);
-    fragColor = vec4(color, 1.0) * texColor;
+    vec4 baseColor = vec4(1.0);
+    if (USE_TEXTURE) {
+        baseColor = texture(textureSampler, fragTexCoord);
+    }
+    if (USE_VERTEX_COLOR) {
+        baseColor.rgb *= color;
+    }
+    if (ALPHA_TEST && baseColor.a < ALPHA_CUTOFF) {
+        discard;
+    }
+    fragColor = baseColor;
 }
\ No newline at end of file
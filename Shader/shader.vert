@@ -13,6 +13,9 @@ layout(set = 0, binding = 0) uniform UboViewProjection {
 layout(location = 0) out vec3 color;
 layout(location = 1) out vec2 fragTexCoord;
 
+// The depth prepass and the opaque pass test EQUAL, the position has to match bit for bit
+invariant gl_Position;
+
 void main() {
     gl_Position = uboViewProjection.projection * uboViewProjection.view * vec4(pos, 1.0);
     color = vcolor;